@@ -1,6 +1,73 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <string>
+#include <vector>
+#include <stack>
+#include <new>
+#include "priokcuts.h"
+
+/* CONSTANTS
+******************************************************************************/
+
+// layouts of the cut store
+#define LAYOUT_SPLIT 0   // costs and inputs in two separate arrays
+#define LAYOUT_AOS   1   // costs and inputs of a vertex interleaved in one record
+
+// size of a cache line, in bytes
+#define CACHE_LINE 64
+
+// huge page policies of the allocation layer
+#define HUGEPAGES_OFF 0   // regular pages
+#define HUGEPAGES_ON  1   // 1 GiB or 2 MiB pages when available, transparent huge pages otherwise
+
+// NUMA placement policies of the allocation layer
+#define NUMA_DEFAULT    0   // placement left to the kernel
+#define NUMA_INTERLEAVE 1   // pages interleaved over all nodes
+#define NUMA_FIRSTTOUCH 2   // each node touches a contiguous slice first
+
+// engines that evaluate the cuts
+#define ENGINE_DFS    0   // depth-first traversal from each output
+#define ENGINE_LEVELS 1   // level-synchronous evaluation on a thread pool
+#define ENGINE_DAG    2   // dependency-driven evaluation with work stealing
+#define ENGINE_SWEEP  3   // single pass over the AND vertices in index order
+#define ENGINE_PARTITIONS 4   // one worker process per partition of the graph
+
+// phases of a run, timed by the engine (see timing.cpp)
+#define PHASE_HEADER      0   // parsing the header of the file
+#define PHASE_DECODE      1   // reading the inputs, the outputs and the AND vertices
+#define PHASE_FANOUT      2   // structural hashing, cone selection and fanout lists
+#define PHASE_INIT        3   // allocating and initializing the cuts (or loading them from the cache)
+#define PHASE_ENUMERATION 4   // evaluating the cuts
+#define PHASE_OUTPUT      5   // showing the cuts and saving them in the cache
+#define NUM_PHASES        6
+
+// hardware performance counters read for each phase (see perfcounters.cpp)
+#define COUNTER_CYCLES        0
+#define COUNTER_INSTRUCTIONS  1
+#define COUNTER_L1D_MISSES    2   // level 1 data cache read misses
+#define COUNTER_LLC_MISSES    3   // last level cache read misses
+#define COUNTER_DTLB_MISSES   4   // data TLB read misses
+#define COUNTER_BRANCH_MISSES 5   // mispredicted branches
+#define NUM_COUNTERS          6
+
+// subsystems of the memory accounting (see memory.cpp)
+#define MEMORY_GRAPH       0   // vertices, fanout lists, polarities and label maps
+#define MEMORY_CUTS        1   // cut store, offsets of the cut lists and origins of the cuts
+#define MEMORY_STACK       2   // stacks of the depth-first traversals
+#define MEMORY_TEMPORARIES 3   // scratch arrays of the engines, products of compute_kcuts, signature tables
+#define NUM_SUBSYSTEMS     4
+
+// maximum number of values of k and of p in a sweep of configurations
+#define MAX_SWEEP 16
+
+// prefix of the names of the POSIX shared memory segments
+#define PARTITION_SEGMENT "/priokcuts"
+
+// version of the cache files (to be increased whenever the cuts computed for
+// a graph or the format of the files change)
+#define CACHE_VERSION 2
+
 /* DATA STRUCTURES
 ******************************************************************************/
 
@@ -11,4 +78,209 @@ typedef struct v {
     int winner;
 } vertex;
 
-#endif
\ No newline at end of file
+// options that are not algorithm parameters
+typedef struct o {
+	int layout;
+	int hugepages;
+	int numa;
+	int engine;
+	int threads;
+	char* cone;      // comma separated positions of the outputs to evaluate (NULL: all)
+	bool stream;     // evaluate the cuts while the file is read
+	int partitions;  // number of worker processes of the partitioned engine
+	char* cache;     // directory of the cache of computed cuts (NULL: no cache)
+	bool reuse;      // reuse the cuts of vertices with structurally identical fanins
+	bool strash;     // merge duplicate AND vertices and remove unreachable ones when loading
+	char* budget;    // memory of an adaptive cut store, in bytes or as a percentage of p cuts per vertex (NULL: p cuts per vertex)
+	bool perf_counters;   // read the hardware performance counters of each phase
+	char* trace;     // file of a timeline of the run in the Chrome trace event format (NULL: no trace)
+	int ks[MAX_SWEEP];   // values of k and p to sweep (-k 4,6,8 -p 2,4)
+	int num_ks;
+	int ps[MAX_SWEEP];
+	int num_ps;
+} run_options;
+
+// everything needed to evaluate the cuts of one graph: every function that
+// works on a graph receives its engine, so several graphs can be evaluated at
+// the same time on different threads (see priokcuts.h for the state shared by
+// the process)
+typedef struct ce {
+
+	// AIG data
+	vertex* vertices;
+	int* outputs;
+	int M;
+	int I;
+	int L;
+	int O;
+	int A;
+	int* fanout_offsets;
+	int* fanout_targets;
+	int capacity;         // vertices allocated (M plus room for added vertices)
+
+	// structural hashing (see strash.cpp): the label in the reduced graph of
+	// each vertex of the file (0: removed) and the label in the file of each
+	// vertex of the reduced graph (NULL: the graph was not reduced)
+	int* label_map;
+	int* original_labels;
+	int original_M;
+	unsigned char* polarities;   // inverted inputs of each vertex (bit 0: left, bit 1: right), kept by the reader for it
+
+	// algorithm parameters and options
+	int p;
+	int k;
+	run_options options;
+	bool verbose;         // show progress messages on the standard output
+
+	// data used to compute the results
+	float* cut_costs;
+	int* cut_inputs;
+	int cost_offset;
+	int input_offset;
+	int cut_rows;         // vertices with room in the cut store
+	long* cut_offsets;    // adaptive budget (see budget.cpp): the cuts of vertex i are the ones from cut_offsets[i] to cut_offsets[i+1] (NULL: p cuts per vertex)
+	bool computed;
+
+	// elapsed time of each phase since the graph was loaded, in seconds
+	double phase_seconds[NUM_PHASES];
+
+	// hardware performance counters of each phase since the graph was loaded
+	// (-1: not available), with their descriptors (-1: not open) and their
+	// values when each phase started
+	double phase_counters[NUM_PHASES][NUM_COUNTERS];
+	int counter_fds[NUM_COUNTERS];
+	double counter_starts[NUM_PHASES][NUM_COUNTERS];
+
+	// vertices edited since the cuts were computed (see eco.cpp)
+	std::vector<int> changed;
+
+	// streaming mode: the costs are not divided by the fanout (not known yet)
+	// and the origin of each cut is saved, so the costs can be normalized
+	// afterwards
+	bool defer_normalization;
+	int* cut_origins;
+	void* stream;
+
+	// cuts evaluated on demand for some vertices only (see lazy.cpp); the
+	// vertices of its view are not in label order, so the label of each vertex
+	// is given (NULL: the label of a vertex is twice its index plus two)
+	void* lazy;
+	const int* labels;
+
+	// cut lists already computed, indexed by the structure of the cuts of the
+	// children (see signatures.cpp; NULL: every vertex is enumerated)
+	void* signatures;
+
+	// timeline being recorded (see trace.cpp; NULL: no trace)
+	void* trace;
+
+	// optional hooks called while the file is processed: once the inputs and
+	// the outputs are known (before the first AND vertex), and after each AND
+	// vertex is added to the graph (the fanouts are only final at the end)
+	void (*graph_allocated)(struct ce* e);
+	void (*vertex_decoded)(struct ce* e, int vertex_index);
+
+	// last error
+	int error;
+	std::string message;
+
+} cut_engine;
+
+// records an error in the engine and returns its code
+int fail(cut_engine* e, int error, const std::string& message);
+
+/* MEMORY ACCOUNTING
+******************************************************************************/
+
+// counts heap memory of a subsystem taken or given back (see memory.cpp)
+void count_allocation(int subsystem, size_t bytes);
+void count_release(int subsystem, size_t bytes);
+
+// allocator of the standard containers whose memory is accounted to a
+// subsystem
+template <class T, int subsystem> struct counted_allocator {
+	typedef T value_type;
+	template <class U> struct rebind { typedef counted_allocator<U, subsystem> other; };
+	counted_allocator() {}
+	template <class U> counted_allocator(const counted_allocator<U, subsystem>&) {}
+	T* allocate(size_t n)
+	{
+		count_allocation(subsystem, n * sizeof(T));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+	void deallocate(T* address, size_t n)
+	{
+		count_release(subsystem, n * sizeof(T));
+		::operator delete(address);
+	}
+};
+template <class T, class U, int subsystem>
+bool operator==(const counted_allocator<T, subsystem>&, const counted_allocator<U, subsystem>&) { return true; }
+template <class T, class U, int subsystem>
+bool operator!=(const counted_allocator<T, subsystem>&, const counted_allocator<U, subsystem>&) { return false; }
+
+// containers of the evaluation: the stack of the depth-first traversals, the
+// leaves of a product of two cuts, and the vectors of the temporary tables
+template <class T> using temporary_vector = std::vector<T, counted_allocator<T, MEMORY_TEMPORARIES>>;
+typedef temporary_vector<int> product_list;
+typedef std::stack<int, std::vector<int, counted_allocator<int, MEMORY_STACK>>> vertex_stack;
+
+/* STATISTICS OF THE CUT ENUMERATION
+ * Only compiled in with -DPK_STATS (make STATS=1, see stats.cpp); otherwise
+ * the macros are empty and the kernel is unchanged.
+******************************************************************************/
+
+// buckets of the histograms (the last one counts every higher value)
+#define STATS_BUCKETS 33
+
+#ifdef PK_STATS
+typedef struct kst {
+	long long vertices;             // vertices enumerated
+	long long pairs;                // pairs of cuts of the children with a product
+	long long empty_pairs;          // pairs with an empty position of a child
+	long long rejected;             // products with more than k leaves
+	long long discarded;            // products of at most k leaves without a position
+	long long fills;                // products placed in an empty position
+	long long replacements;         // products placed over a cut of higher cost
+	long long autocut_fills;        // autocuts placed in an empty position
+	long long autocut_replacements; // autocuts placed over a cut of higher cost
+	long long loser_evictions;      // autocuts placed over the loser cut
+	long long leaves[STATS_BUCKETS];     // products by number of leaves
+	long long occupancy[STATS_BUCKETS];  // vertices by number of cuts kept
+} kernel_statistics;
+
+// statistics of the calling thread
+kernel_statistics& thread_statistics();
+
+#define KERNEL_STATS kernel_statistics& stats = thread_statistics()
+#define KERNEL_STAT(counter) (stats.counter++)
+#define KERNEL_HISTOGRAM(histogram, value) (stats.histogram[(value) < STATS_BUCKETS - 1 ? (value) : STATS_BUCKETS - 1]++)
+#else
+#define KERNEL_STATS
+#define KERNEL_STAT(counter) ((void)0)
+#define KERNEL_HISTOGRAM(histogram, value) ((void)0)
+#endif
+
+/* CUT STORE
+******************************************************************************/
+
+// position of the first cost of the cut list of a vertex (the positions of a
+// large store do not fit in an int)
+inline size_t cost_start(const cut_engine* e, int vertex_index)
+{
+	return e->cut_offsets != NULL ? (size_t)e->cut_offsets[vertex_index] : (size_t)vertex_index * e->cost_offset;
+}
+
+// position of the first input of the cut list of a vertex
+inline size_t input_start(const cut_engine* e, int vertex_index)
+{
+	return e->cut_offsets != NULL ? (size_t)e->cut_offsets[vertex_index] * e->k : (size_t)vertex_index * e->input_offset;
+}
+
+// number of cuts the cut list of a vertex has room for
+inline int cut_slots(const cut_engine* e, int vertex_index)
+{
+	return e->cut_offsets != NULL ? (int)(e->cut_offsets[vertex_index + 1] - e->cut_offsets[vertex_index]) : e->p;
+}
+
+#endif
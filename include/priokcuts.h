@@ -0,0 +1,169 @@
+#ifndef PRIOKCUTS_H
+#define PRIOKCUTS_H
+
+#include <stddef.h>
+
+/* PRIORITY K-CUTS LIBRARY
+ *
+ * An engine holds one graph and its cuts. Engines are independent, so several
+ * graphs can be loaded and evaluated at the same time on different threads
+ * (one thread per engine at a time), with two limits: the memory accounting
+ * and the statistics of the enumeration are totals of the process, and the
+ * partitioned engine forks worker processes, so it must not be run while
+ * other threads of the process use the library. Each engine writes its own
+ * trace. The functions return PK_OK or one of the error codes below, and no
+ * exception escapes them; pk_last_error describes the last error of an engine.
+ * The vertices are identified by their AIGER label (twice their index), the
+ * label in the file also when the graph is reduced by structural hashing.
+******************************************************************************/
+
+// error codes
+#define PK_OK                  0
+#define PK_ERROR_ARGUMENT     -1   // invalid argument or option value
+#define PK_ERROR_OPEN         -2   // the file could not be opened
+#define PK_ERROR_FORMAT       -3   // the AIG is invalid or truncated
+#define PK_ERROR_UNSUPPORTED  -4   // the AIG has latches
+#define PK_ERROR_MEMORY       -5   // not enough memory
+#define PK_ERROR_STATE        -6   // no graph loaded or cuts not computed yet
+#define PK_ERROR_WORKER       -7   // a worker process failed
+#define PK_ERROR_OPTION       -8   // unknown option
+#define PK_ERROR_INTERNAL     -9   // unexpected failure inside the library
+
+/* QUERY SERVER PROTOCOL (priokcuts --serve <socket>)
+ *
+ * Over a Unix domain stream socket, a request is a sequence of 32-bit
+ * integers in the byte order of the machine: the operation, the number of
+ * arguments and the arguments. The reply is the status (PK_OK or an error
+ * code), the size of the payload in bytes and the payload: the message of the
+ * error, or 32-bit words where the costs are 32-bit floats. The cut list of a
+ * vertex is its label, the number of cuts and, for each cut, its cost, its
+ * number of leaves and the leaves. A reply whose payload would exceed INT_MAX
+ * bytes (a batch of many vertices with large k and p) is replaced by a
+ * PK_ERROR_ARGUMENT error. If a new evaluation fails, the cuts of the
+ * previous k and p are evaluated again.
+******************************************************************************/
+#define PK_SERVE_INFO      0   // (): number of vertices, inputs, outputs, AND vertices, k and p
+#define PK_SERVE_CUTS      1   // (label): the cut list of the vertex
+#define PK_SERVE_WINNER    2   // (label): the label, the index of the winner cut among the cuts, and the cut
+#define PK_SERVE_BATCH     3   // (labels...): the number of vertices and the cut list of each
+#define PK_SERVE_RECOMPUTE 4   // (p [, k]): evaluates the cuts again; the new k and p
+#define PK_SERVE_SHUTDOWN  5   // (): stops the server after the reply
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ce pk_engine;
+
+// creates an engine computing p cuts of at most k inputs per vertex (NULL if
+// k or p is less than 2 or there is not enough memory)
+pk_engine* pk_create(int k, int p);
+
+// releases an engine with its graph and its cuts
+void pk_destroy(pk_engine* engine);
+
+// sets an option, using the names of the long command line options without
+// the dashes ("layout", "engine", "threads", "cone", "partitions", "stream",
+// "cache", "reuse", "strash", "budget", "perf-counters", "trace", "hugepages",
+// "numa"); flags take NULL, "1" or "0"
+// cone, stream and trace are applied when the graph is loaded, the others when
+// the cuts are computed
+int pk_set_option(pk_engine* engine, const char* name, const char* value);
+
+// loads a graph in the AIGER format (binary or ASCII), replacing the previous one
+int pk_load_file(pk_engine* engine, const char* filename);
+int pk_load_buffer(pk_engine* engine, const char* data, size_t size);
+
+// evaluates the cuts of the graph
+int pk_compute(pk_engine* engine);
+
+// edits the graph after the cuts were computed (the labels follow the AIGER
+// format and the inputs of a vertex must have lower labels): gives new inputs
+// to an AND vertex, adds an AND vertex after the last one (returning its
+// label), removes an AND vertex without fanout, or drives the output at a
+// position (starting at 0) with another literal
+int pk_replace_node(pk_engine* engine, int label, int rhs0, int rhs1);
+int pk_add_node(pk_engine* engine, int rhs0, int rhs1);
+int pk_remove_node(pk_engine* engine, int label);
+int pk_set_output(pk_engine* engine, int position, int literal);
+
+// updates the cuts after the edits, evaluating only the transitive fanout of
+// the edited vertices; returns the number of vertices evaluated or an error code
+int pk_recompute(pk_engine* engine);
+
+// evaluates only the cuts of a vertex and of its transitive fanin, without
+// pk_compute; the cuts are kept for the next queries until the graph changes,
+// so only the part of the fanin not seen yet is evaluated; returns the number
+// of vertices evaluated
+int pk_query(pk_engine* engine, int label);
+
+// number of vertices (M) of the graph
+int pk_num_vertices(const pk_engine* engine);
+
+// number of cuts of a vertex, or an error code (the engine is not const, as
+// an error is recorded in it)
+int pk_num_cuts(pk_engine* engine, int label);
+
+// copies the index-th cut of a vertex: its inputs (labels) to leaves, which
+// must have room for k values, and its cost; returns the number of inputs or
+// an error code
+int pk_get_cut(pk_engine* engine, int label, int index, int* leaves, float* cost);
+
+// description of the last error of the engine
+const char* pk_last_error(const pk_engine* engine);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// C++ interface: owns an engine and turns the error codes into exceptions
+class CutEngine
+{
+public:
+	CutEngine(int k = 4, int p = 2) : k(k), engine(pk_create(k, p)) { if(engine == NULL) throw std::runtime_error("Failed to create the engine."); }
+	~CutEngine() { pk_destroy(engine); }
+	CutEngine(const CutEngine&) = delete;
+	CutEngine& operator=(const CutEngine&) = delete;
+
+	void set_option(const std::string& name, const std::string& value) { check(pk_set_option(engine, name.c_str(), value.c_str())); }
+	void load_file(const std::string& filename) { check(pk_load_file(engine, filename.c_str())); }
+	void load_buffer(const char* data, size_t size) { check(pk_load_buffer(engine, data, size)); }
+	void compute() { check(pk_compute(engine)); }
+	void replace_node(int label, int rhs0, int rhs1) { check(pk_replace_node(engine, label, rhs0, rhs1)); }
+	int add_node(int rhs0, int rhs1) { return check(pk_add_node(engine, rhs0, rhs1)); }
+	void remove_node(int label) { check(pk_remove_node(engine, label)); }
+	void set_output(int position, int literal) { check(pk_set_output(engine, position, literal)); }
+	int recompute() { return check(pk_recompute(engine)); }
+	int query(int label) { return check(pk_query(engine, label)); }
+	int num_vertices() const { return pk_num_vertices(engine); }
+	int num_cuts(int label) { return check(pk_num_cuts(engine, label)); }
+
+	// inputs of the index-th cut of a vertex
+	std::vector<int> cut(int label, int index, float* cost = NULL)
+	{
+		std::vector<int> leaves(k);
+		float c;
+		leaves.resize(check(pk_get_cut(engine, label, index, leaves.data(), &c)));
+		if(cost != NULL) *cost = c;
+		return leaves;
+	}
+
+	pk_engine* handle() { return engine; }
+
+private:
+	int check(int status) const
+	{
+		if(status < 0) throw std::runtime_error(pk_last_error(engine));
+		return status;
+	}
+
+	int k;
+	pk_engine* engine;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/* POOL OF WORKER THREADS
+ * The calling thread also works, so a pool of N threads starts N-1 workers.
+******************************************************************************/
+
+class thread_pool
+{
+public:
+	thread_pool(int threads);
+	~thread_pool();
+
+	// number of threads that run the jobs (including the caller)
+	int size() const { return workers.size() + 1; }
+
+	// runs body(first, last) over chunks of at most grain elements of
+	// [begin, end) and returns when all the chunks are done
+	void parallel_for(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+private:
+	void work();
+	void run_chunks();
+
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)>* job;
+	std::atomic<int> next;
+	int last;
+	int grain;
+	unsigned generation;
+	int active;
+	bool stopping;
+};
+
+#endif
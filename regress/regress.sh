@@ -0,0 +1,275 @@
+#!/bin/bash
+#
+# Regression harness: runs priokcuts over the graphs of aiger/ and a few
+# synthetic graphs (written by aiggen, always the same for a seed) for each
+# (k, p) pair, and checks
+#   - the digest of the complete cut output (-d) against regress/golden.txt,
+#     for the default run and for each engine and option of VARIANTS
+#   - the peak resident memory against regress/baseline.txt, within a
+#     tolerance (in percent)
+#   - with REGRESS_TIMING=1, the best total time of a few runs against the
+#     baseline, scaled by the speed of this machine (measured by a fixed awk
+#     loop) relative to the machine that wrote the baseline
+# and that random edits applied with --eco give the same cuts as a full run
+# of the edited graph. With --update the two files are written again from
+# this run instead.
+#
+# Usage: regress.sh [--update]
+# Environment: REGRESS_KP ("4,2 6,4"), REGRESS_TIMING (1 checks the times),
+# REGRESS_REPS (runs timed per pair), REGRESS_TOLERANCE (percent), REGRESS_DIR
+# (directory of the synthetic graphs), REGRESS_ECO_SEEDS (seeds of the random
+# edits), REGRESS_ECO_EDITS (edits per seed)
+
+KP=${REGRESS_KP:-"4,2 4,4 6,4 8,8"}
+TIMING=${REGRESS_TIMING:-0}
+REPS=${REGRESS_REPS:-3}
+TOLERANCE=${REGRESS_TOLERANCE:-25}
+DIR=${REGRESS_DIR:-build/regress}
+GOLDEN=regress/golden.txt
+BASELINE=regress/baseline.txt
+
+# times below this many seconds are mostly noise, so they get it as slack
+SLACK=0.005
+
+update=0
+if [ "$1" == "--update" ]; then update=1; fi
+
+# synthetic graphs: name and aiggen parameters
+mkdir -p $DIR
+SYNTHETIC=(
+	"syn-uniform.aig -n 20000 -d 40 --seed 1"
+	"syn-hubs.aig -n 20000 -d 80 -s 3 -r 0.3 --seed 2"
+	"syn-wide.aag -n 50000 -i 2000 -o 2000 -d 12 -r 0.05 --seed 3"
+)
+files=`ls aiger/*.aag aiger/*.aig 2>/dev/null`
+for s in "${SYNTHETIC[@]}"; do
+	set -- $s
+	name=$1; shift
+	./aiggen $DIR/$name "$@" 2> /dev/null || { echo "FAIL. Could not write $DIR/$name."; exit 1; }
+	files="$files $DIR/$name"
+done
+
+# a graph with dead logic (every aiggen graph is fully reachable): the wide
+# graph with only its first quarter of outputs, so the logic of the others,
+# fanout included, is not reached by the outputs and must not be evaluated
+awk 'NR == 1 { i = $3; l = $4; o = $5; kept = int(o / 4); $5 = kept; print; next }
+	NR <= 1 + i + l || NR > 1 + i + l + o || NR <= 1 + i + l + kept' $DIR/syn-wide.aag > $DIR/syn-dead.aag
+files="$files $DIR/syn-dead.aag"
+
+# engines and options whose cuts are checked too: the tag of their digests
+# in the golden file and the options (the cache is filled by a first run and
+# the digest is the one of the run that loads it)
+VARIANTS=(
+	"engine=levels --engine levels -t 2"
+	"engine=dag --engine dag -t 2"
+	"engine=sweep --engine sweep"
+	"partitions=2 --partitions 2"
+	"stream --stream -t 2"
+	"layout=aos --layout aos"
+	"budget=125% --budget 125%"
+	"reuse --reuse"
+	"strash --strash"
+	"cache --cache $DIR/cache"
+)
+
+# digest of the cuts of a run (the lines of the vertices and of their cuts),
+# or "failed"
+cuts_digest() {
+	output=`./priokcuts "$@" -d` || { echo failed; return; }
+	echo "$output" | grep -E "^v\[|^  \{" | md5sum | cut -c1-32
+}
+
+# field of the line of a key in a file, among the given number of fields
+# after the key (so a key is not taken for the start of a longer one)
+lookup() {
+	awk -v key="$2" -v fields=$3 -v field=$4 'substr($0, 1, length(key) + 1) == key " " && split(substr($0, length(key) + 2), f, " ") == fields { print f[field] }' $1
+}
+
+# best time of a fixed awk loop, the speed of the machine for the baseline
+probe() {
+	best=""
+	for r in 1 2 3; do
+		start=`date +%s.%N`
+		awk 'BEGIN { for(i = 0; i < 3000000; i++) s += i * i }'
+		end=`date +%s.%N`
+		best=`awk -v a="$start" -v b="$end" -v c="$best" 'BEGIN { t = b - a; print (c == "" || t < c + 0) ? t : c }'`
+	done
+	echo $best
+}
+
+failures=0
+checked=0
+
+# compares a digest with the golden one
+check_digest() {
+	checked=$((checked + 1))
+	golden=`lookup $GOLDEN "$1" 1 1`
+	if [ -z "$golden" ]; then
+		echo "NEW   $1: no golden digest"
+		failures=$((failures + 1))
+		return 1
+	fi
+	if [ "$golden" != "$2" ]; then
+		echo "FAIL  $1: the cuts changed ($2, golden $golden)"
+		failures=$((failures + 1))
+		return 1
+	fi
+	return 0
+}
+
+if [ $update -eq 1 ]; then
+	: > $GOLDEN.new
+	: > $BASELINE.new
+	echo "probe `probe`" >> $BASELINE.new
+	TIMING=1
+fi
+scale=1
+if [ $update -eq 0 ] && [ "$TIMING" == "1" ]; then
+	old_probe=`awk '$1 == "probe" { print $2 }' $BASELINE 2>/dev/null`
+	if [ -n "$old_probe" ]; then scale=`awk -v a="$(probe)" -v b="$old_probe" 'BEGIN { print a / b }'`; fi
+	echo "Times scaled by $scale (speed of this machine relative to the baseline)."
+fi
+runs=1
+if [ "$TIMING" == "1" ]; then runs=$REPS; fi
+
+for f in $files; do
+	for kp in $KP; do
+		k=${kp%,*}; p=${kp#*,}
+		key="`basename $f` k=$k p=$p"
+		digest=`cuts_digest $f -k $k -p $p`
+
+		# best time and peak memory of the runs
+		best=""
+		memory=""
+		for r in $(seq $runs); do
+			line=`./priokcuts $f -k $k -p $p --metrics json`
+			total=`echo "$line" | sed 's/.*"total":\([^,]*\),.*/\1/'`
+			peak=`echo "$line" | sed 's/.*"peak_memory":\([0-9]*\).*/\1/'`
+			best=`awk -v a="$total" -v b="$best" 'BEGIN { print (b == "" || a + 0 < b + 0) ? a : b }'`
+			memory=`awk -v a="$peak" -v b="$memory" 'BEGIN { print (b == "" || a + 0 < b + 0) ? a : b }'`
+		done
+
+		# the digests of the engines and options
+		for v in "${VARIANTS[@]}"; do
+			set -- $v
+			tag=$1; shift
+			if [ $tag == "cache" ]; then
+				rm -rf $DIR/cache
+				./priokcuts $f -k $k -p $p "$@" > /dev/null
+			fi
+			variant=`cuts_digest $f -k $k -p $p "$@"`
+			if [ $update -eq 1 ]; then echo "$key $tag $variant" >> $GOLDEN.new
+			elif check_digest "$key $tag" $variant; then echo "OK    $key $tag"; fi
+		done
+
+		if [ $update -eq 1 ]; then
+			echo "$key $digest" >> $GOLDEN.new
+			echo "$key $best $memory" >> $BASELINE.new
+			continue
+		fi
+
+		check_digest "$key" $digest || continue
+		old_time=`lookup $BASELINE "$key" 2 1`
+		old_memory=`lookup $BASELINE "$key" 2 2`
+		if [ -z "$old_time" ]; then
+			echo "OK    $key (no baseline)"
+			continue
+		fi
+		verdict=`awk -v t="$best" -v m="$memory" -v ot="$old_time" -v om="$old_memory" -v tol="$TOLERANCE" -v slack="$SLACK" -v timing="$TIMING" -v scale="$scale" 'BEGIN {
+			v = "";
+			if(timing == 1 && t > ot * scale * (1 + tol / 100) + slack) v = v sprintf(" time %.4fs > %.4fs", t, ot * scale);
+			if(m > om * (1 + tol / 100)) v = v sprintf(" memory %d > %d bytes", m, om);
+			print v }'`
+		if [ -n "$verdict" ]; then
+			echo "SLOW  $key:$verdict (tolerance $TOLERANCE%)"
+			failures=$((failures + 1))
+		elif [ "$TIMING" == "1" ]; then
+			printf "OK    %s: %.4fs (baseline %.4fs), %d bytes (baseline %d)\n" "$key" $best `awk -v a=$old_time -v b=$scale 'BEGIN { print a * b }'` $memory $old_memory
+		else
+			printf "OK    %s: %d bytes (baseline %d)\n" "$key" $memory $old_memory
+		fi
+	done
+done
+
+# incremental updates: random edits of the ASCII graphs applied with --eco
+# must give the same cuts as a full run of the edited graph, for each engine
+# and layout (nothing to write with --update: the reference is the full run)
+eco_graph() {
+	awk -v seed=$2 -v edits=$3 -v count=$ECO_EDITS '
+	function literal(label,    top) {
+		top = int(label / 2) - 1
+		if(top < 1 || rand() < 0.05) return int(rand() * 2)
+		return 2 * (1 + int(rand() * top)) + int(rand() * 2)
+	}
+	function set(a, x, y) {
+		if(x < y) { r0[a] = y; r1[a] = x } else { r0[a] = x; r1[a] = y }
+	}
+	NR == 1 { M = $2; I = $3; O = $5; A = $6; next }
+	NR <= 1 + I { next }
+	NR <= 1 + I + O { out[NR - 2 - I] = $1; next }
+	NR <= 1 + I + O + A { set(NR - 2 - I - O, $2, $3); next }
+	END {
+		srand(seed)
+		for(n = 0; n < count; n++) {
+			t = rand()
+			if(t < 0.45 && A > 0) {
+				a = int(rand() * A); label = 2 * (I + 1 + a)
+				x = literal(label); y = literal(label)
+				set(a, x, y); print "replace", label, x, y > edits
+			} else if(t < 0.65) {
+				label = 2 * (M + 1)
+				x = literal(label); y = literal(label)
+				set(A, x, y); A++; M++; print "add", x, y > edits
+			} else if(t < 0.85 && O > 0) {
+				position = int(rand() * O); l = int(rand() * (2 * M + 2))
+				out[position] = l; print "output", position, l > edits
+			} else {
+				split("", fanout); dead = 0
+				for(a = 0; a < A; a++) { fanout[int(r0[a] / 2)]++; fanout[int(r1[a] / 2)]++ }
+				for(i = 0; i < O; i++) fanout[int(out[i] / 2)]++
+				for(a = 0; a < A; a++) if(!fanout[I + 1 + a]) candidates[dead++] = a
+				if(dead == 0) { n--; continue }
+				a = candidates[int(rand() * dead)]
+				set(a, 0, 0); print "remove", 2 * (I + 1 + a) > edits
+			}
+		}
+		print "aag", M, I, 0, O, A
+		for(i = 1; i <= I; i++) print 2 * i
+		for(i = 0; i < O; i++) print out[i]
+		for(a = 0; a < A; a++) print 2 * (I + 1 + a), r0[a], r1[a]
+	}' $1
+}
+
+ECO_SEEDS=${REGRESS_ECO_SEEDS:-"1 2 3 4"}
+ECO_EDITS=${REGRESS_ECO_EDITS:-8}
+ECO_OPTIONS=("--engine dfs" "--engine levels" "--engine dag" "--engine sweep" "--partitions 2" "--layout aos")
+if [ $update -eq 0 ]; then
+	for f in `ls aiger/*.aag` $DIR/syn-wide.aag $DIR/syn-dead.aag; do
+		for seed in $ECO_SEEDS; do
+			edits=$DIR/eco-`basename $f .aag`-$seed.txt
+			edited=$DIR/eco-`basename $f .aag`-$seed.aag
+			eco_graph $f $seed $edits > $edited
+			for o in "${ECO_OPTIONS[@]}"; do
+				checked=$((checked + 1))
+				key="`basename $f` eco seed=$seed $o"
+				incremental=`./priokcuts $f -k 6 -p 4 $o --eco $edits -d 2>&1 | grep -E "^v\[|^  \{" | md5sum | cut -c1-32`
+				full=`./priokcuts $edited -k 6 -p 4 $o -d 2>&1 | grep -E "^v\[|^  \{" | md5sum | cut -c1-32`
+				if [ "$incremental" != "$full" ]; then
+					echo "FAIL  $key: the cuts after the edits differ from a full run of $edited"
+					failures=$((failures + 1))
+				else
+					echo "OK    $key"
+				fi
+			done
+		done
+	done
+fi
+
+if [ $update -eq 1 ]; then
+	mv $GOLDEN.new $GOLDEN
+	mv $BASELINE.new $BASELINE
+	echo "Golden digests written to $GOLDEN and baseline to $BASELINE."
+	exit 0
+fi
+echo "$((checked - failures)) of $checked runs passed."
+[ $failures -eq 0 ]
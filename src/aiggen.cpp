@@ -0,0 +1,282 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+using namespace std;
+
+// largest graph the program reads (labels are ints)
+#define MAX_VERTICES 1073741823LL
+
+// parameters of a generated graph
+typedef struct gp {
+	long long ands;
+	long long inputs;
+	long long outputs;
+	long long depth;
+	double skew;            // 1: children uniform in a level; higher: a few vertices get most of the fanout
+	double reconvergence;   // probability of taking the second child from the fanin of the first
+	unsigned long long seed;
+	bool ascii;
+} generator_params;
+
+/* SYNTHETIC AIG GENERATOR
+ *
+ * The AND vertices are split in exactly the given number of depth levels of
+ * consecutive indices, as even as possible (level 0 is the inputs). The first
+ * child of a vertex of level l is in level l-1, so the graph has exactly the
+ * given depth. Every vertex of level l-1 is a child of a vertex of level l:
+ * the j-th vertex of level l takes as first child the j-th vertex of a
+ * shuffled order of level l-1 and, while the level below is wider than its
+ * own, the (j + width)-th as second child (the inputs beyond twice the width
+ * of the first level are left unused). The other children are random: the
+ * first one in level l-1, the second one in a random level below l or, with
+ * the probability of reconvergence, the first child of the first child, so two
+ * paths from the vertex meet again. Within a level a random child is the
+ * vertex at offset width * u^skew for a uniform u, which gives a uniform
+ * fanout with skew 1 and a few hubs of high fanout with higher skews. Every
+ * vertex of the last level is an output (so there are at least as many
+ * outputs as its width) and the other outputs are spread evenly over the
+ * levels below, so the whole graph is reachable from the outputs.
+ * The children of a vertex only depend on the seed and on its index (they
+ * come from a hash of both), so nothing is kept in memory and the graph is
+ * written as it is generated, for any size up to what the reader accepts.
+******************************************************************************/
+
+// mixes a seed and a value into 64 random bits (splitmix64)
+inline unsigned long long mix(unsigned long long seed, unsigned long long value)
+{
+	unsigned long long z = seed + value * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// uniform number in [0, 1) from 64 random bits
+inline double uniform(unsigned long long bits)
+{
+	return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// first vertex of a level (the first levels have one vertex more than the
+// others when the depth does not divide the AND vertices)
+inline long long level_first(const generator_params& g, long long level)
+{
+	if(level == 0) return 0;
+	long long extra = g.ands % g.depth;
+	return g.inputs + (level - 1) * (g.ands / g.depth) + (level - 1 < extra ? level - 1 : extra);
+}
+
+// number of vertices of a level
+inline long long level_width(const generator_params& g, long long level)
+{
+	return level == 0 ? g.inputs : level_first(g, level + 1) - level_first(g, level);
+}
+
+// level of a vertex given by its index (0 for the inputs)
+inline long long level_of(const generator_params& g, long long vertex_index)
+{
+	if(vertex_index < g.inputs) return 0;
+	long long offset = vertex_index - g.inputs;
+	long long width = g.ands / g.depth;
+	long long wide = (g.ands % g.depth) * (width + 1);
+	return offset < wide ? offset / (width + 1) + 1 : g.ands % g.depth + (offset - wide) / width + 1;
+}
+
+// picks a random vertex of a level
+inline long long pick(const generator_params& g, long long level, unsigned long long bits)
+{
+	long long width = level_width(g, level);
+	double u = uniform(bits);
+	long long offset = (long long)(width * (g.skew == 1.0 ? u : pow(u, g.skew)));
+	return level_first(g, level) + (offset < width ? offset : width - 1);
+}
+
+inline long long gcd(long long a, long long b)
+{
+	while(b != 0)
+	{
+		long long r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+// the position-th vertex of a level in a shuffled order of the level (an
+// affine permutation of its positions drawn from the seed and the level)
+inline long long shuffled(const generator_params& g, long long level, long long position)
+{
+	long long width = level_width(g, level);
+	unsigned long long bits = mix(g.seed ^ 0x85ebca6bULL, level);
+	long long multiplier = (long long)(bits % width) | 1;
+	while(gcd(multiplier, width) != 1) multiplier++;
+	long long offset = (long long)((bits >> 32) % width);
+	return level_first(g, level) + (long long)(((unsigned long long)multiplier * position + offset) % width);
+}
+
+// first child of an AND vertex
+inline long long first_child(const generator_params& g, long long vertex_index)
+{
+	long long level = level_of(g, vertex_index);
+	long long position = vertex_index - level_first(g, level);
+	if(position < level_width(g, level - 1)) return shuffled(g, level - 1, position);
+	return pick(g, level - 1, mix(g.seed, 4 * vertex_index));
+}
+
+// literals of the children of an AND vertex (the first one is the greater)
+void children(const generator_params& g, long long vertex_index, long long& rhs0, long long& rhs1)
+{
+	long long level = level_of(g, vertex_index);
+	long long position = vertex_index - level_first(g, level) + level_width(g, level);
+	long long left = first_child(g, vertex_index);
+	long long right;
+	if(position < level_width(g, level - 1)) right = shuffled(g, level - 1, position);
+	else if(left >= g.inputs && uniform(mix(g.seed, 4 * vertex_index + 1)) < g.reconvergence) right = first_child(g, left);
+	else right = pick(g, mix(g.seed, 4 * vertex_index + 2) % level, mix(g.seed, 4 * vertex_index + 3));
+	if(right == left) right = left > 0 ? left - 1 : left + 1;
+
+	unsigned long long polarities = mix(g.seed ^ 0x5bd1e995ULL, vertex_index);
+	long long left_literal = (left + 1) * 2 + (polarities & 1);
+	long long right_literal = (right + 1) * 2 + ((polarities >> 1) & 1);
+	rhs0 = left_literal > right_literal ? left_literal : right_literal;
+	rhs1 = left_literal > right_literal ? right_literal : left_literal;
+}
+
+// writes a delta in the AIGER binary format: 7 bits per byte, the high bit
+// set on all bytes but the last
+inline void encode(FILE* output, unsigned long long x)
+{
+	while(x & ~0x7fULL)
+	{
+		putc_unlocked((int)((x & 0x7f) | 0x80), output);
+		x >>= 7;
+	}
+	putc_unlocked((int)x, output);
+}
+
+// writes the graph in the AIGER binary or ASCII format
+bool write_graph(const generator_params& g, FILE* output)
+{
+	long long M = g.inputs + g.ands;
+	fprintf(output, "%s %lld %lld 0 %lld %lld\n", g.ascii ? "aag" : "aig", M, g.inputs, g.outputs, g.ands);
+	if(g.ascii) for(long long i = 0; i < g.inputs; i++) fprintf(output, "%lld\n", (i + 1) * 2);
+	// the outputs below the last level, spread evenly, then the last level
+	long long top = level_first(g, g.depth);
+	long long spread = g.outputs - (M - top);
+	for(long long j = spread - 1; j >= 0; j--)
+	{
+		long long i = top - 1 - j * ((top - g.inputs) / spread);
+		fprintf(output, "%lld\n", (i + 1) * 2 + (mix(g.seed ^ 0x27d4eb2fULL, i) & 1));
+	}
+	for(long long i = top; i < M; i++) fprintf(output, "%lld\n", (i + 1) * 2 + (mix(g.seed ^ 0x27d4eb2fULL, i) & 1));
+	for(long long i = g.inputs; i < M; i++)
+	{
+		long long rhs0, rhs1;
+		children(g, i, rhs0, rhs1);
+		long long label = (i + 1) * 2;
+		if(g.ascii) fprintf(output, "%lld %lld %lld\n", label, rhs0, rhs1);
+		else
+		{
+			encode(output, label - rhs0);
+			encode(output, rhs0 - rhs1);
+		}
+	}
+	return !ferror(output);
+}
+
+// show the help on screen
+void show_help(char* argv[])
+{
+	cerr << endl << "  \e[1mUsage:\e[0m " << argv[0] << " <file> -n <ands> [options]" << endl << endl;
+	cerr << "  <file>         The AIG to write: ASCII if its name ends in .aag, binary" << endl;
+	cerr << "                 otherwise ('-' writes the binary format to the standard output)." << endl << endl;
+	cerr << "  \e[1mOptions\e[0m:" << endl << endl;
+	cerr << "  -n <value>     The number of AND vertices." << endl;
+	cerr << "  -i <value>     The number of inputs (default: 1% of the AND vertices, at least 2)." << endl;
+	cerr << "  -o <value>     The number of outputs (default: as many as the inputs; at least" << endl;
+	cerr << "                 the width of the last level, whose vertices are all outputs)." << endl;
+	cerr << "  -d <value>     The depth, in levels of AND vertices (default 100)." << endl;
+	cerr << "  -s <value>     The skew of the fanout: 1 for a uniform fanout (default), higher" << endl;
+	cerr << "                 for a few vertices with most of the fanout." << endl;
+	cerr << "  -r <value>     The probability of a reconvergent second child (default 0.1)." << endl;
+	cerr << "  --seed <n>     The seed: the same parameters and seed give the same file" << endl;
+	cerr << "                 (default 1)." << endl << endl;
+}
+
+/* MAIN FUNCTION: WRITES A SYNTHETIC AIG
+******************************************************************************/
+int main(int argc, char* argv[])
+{
+	generator_params g;
+	g.ands = 0;
+	g.inputs = 0;
+	g.outputs = 0;
+	g.depth = 100;
+	g.skew = 1.0;
+	g.reconvergence = 0.1;
+	g.seed = 1;
+	char* filename = NULL;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-") != 0 && argv[i][0] == '-' && i + 1 >= argc)
+		{
+			show_help(argv);
+			return -1;
+		}
+		if(strcmp(argv[i], "-n") == 0) g.ands = atoll(argv[++i]);
+		else if(strcmp(argv[i], "-i") == 0) g.inputs = atoll(argv[++i]);
+		else if(strcmp(argv[i], "-o") == 0) g.outputs = atoll(argv[++i]);
+		else if(strcmp(argv[i], "-d") == 0) g.depth = atoll(argv[++i]);
+		else if(strcmp(argv[i], "-s") == 0) g.skew = atof(argv[++i]);
+		else if(strcmp(argv[i], "-r") == 0) g.reconvergence = atof(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0) g.seed = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "-") != 0 && argv[i][0] == '-')
+		{
+			show_help(argv);
+			return -1;
+		}
+		else filename = argv[i];
+	}
+	if(g.inputs == 0) g.inputs = g.ands / 100 > 2 ? g.ands / 100 : 2;
+	if(g.outputs == 0) g.outputs = g.inputs;
+	if(g.depth > g.ands) g.depth = g.ands;
+	if(g.depth >= 1 && g.outputs < level_width(g, g.depth)) g.outputs = level_width(g, g.depth);
+	if(filename == NULL || g.ands < 1 || g.inputs < 2 || g.depth < 1 || g.skew < 1.0 || g.reconvergence < 0 || g.reconvergence > 1)
+	{
+		show_help(argv);
+		return -1;
+	}
+	if(g.inputs + g.ands > MAX_VERTICES)
+	{
+		cerr << "FAIL. At most " << MAX_VERTICES << " vertices (inputs and AND vertices)." << endl;
+		return -1;
+	}
+	if(g.outputs > g.ands)
+	{
+		cerr << "FAIL. The outputs are AND vertices, so there cannot be more outputs than AND vertices." << endl;
+		return -1;
+	}
+
+	string name = filename;
+	g.ascii = name.size() > 4 && name.substr(name.size() - 4) == ".aag";
+	FILE* output = name == "-" ? stdout : fopen(filename, "wb");
+	if(output == NULL)
+	{
+		cerr << "FAIL. Failed to create the output file." << endl;
+		return -1;
+	}
+	static char buffer[1 << 20];
+	setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+	bool written = write_graph(g, output);
+	written = (output == stdout ? fflush(output) : fclose(output)) == 0 && written;
+	if(!written)
+	{
+		cerr << "FAIL. Failed to write the output file." << endl;
+		return -1;
+	}
+	cerr << "Wrote " << g.inputs + g.ands << " vertices (" << g.inputs << " inputs, " << g.ands << " AND vertices in "
+		 << g.depth << " levels, " << g.outputs << " outputs) with seed " << g.seed << "." << endl;
+	return 0;
+}
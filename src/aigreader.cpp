@@ -1,20 +1,24 @@
 #include <iostream>
-#include <fstream>
 #include <cstring>
+#include <string>
 #include "graph.h"
 using namespace std;
 
-// get a char from a file in the AIGER binary format
-unsigned char getnoneofch(ifstream& input_file)
+// functions and procedures implemented elsewhere
+void* allocate_memory(size_t bytes, const char* name);
+double begin_phase(cut_engine* e, int phase);
+void end_phase(cut_engine* e, int phase, double start);
+
+// get a char from a file in the AIGER binary format (0 at the end of the
+// file, which leaves the stream in the failed state)
+unsigned char getnoneofch(istream& input_file)
 {
 	int ch = input_file.get();
-	if(ch != EOF) return ch;
-	cerr << "*** decode: unexpected EOF" << endl;
-	exit(-1);
+	return ch != EOF ? ch : 0;
 }
 
 // decodes a delta encoding from a file in the AIGER binary format
-unsigned int decode(ifstream& input_file)
+unsigned int decode(istream& input_file)
 {
 	unsigned x = 0, i = 0;
 	unsigned char ch;
@@ -26,27 +30,41 @@ unsigned int decode(ifstream& input_file)
 }
 
 // process the file in the ASCII format
-void process_ascii_format(ifstream& input_file, int& M, int& I, int& L, int& O, int& A, vertex*& vertices, int*& outputs)
+int process_ascii_format(cut_engine* e, istream& input_file)
 {
+	int M = e->M;
+	int I = e->I;
+	int L = e->L;
+	int O = e->O;
+	int A = e->A;
 	char* token;
+	char* save;
 	char buffer[256];
 	// check for latches
 	if(L != 0)
 	{
-		cerr << "This graph contains latches. The current version of this implementation do not support them." << endl;
-		exit(-1);
+		return fail(e, PK_ERROR_UNSUPPORTED, "This graph contains latches. The current version of this implementation do not support them.");
 	}
 
 	// integrity check #1
 	if(M != I + L + A)
 	{
-		cerr << "This graph is invalid. M != I + L + A." << endl;
-		exit(-1);
+		return fail(e, PK_ERROR_FORMAT, "This graph is invalid. M != I + L + A.");
 	}
 
 	// Memory allocation
-	outputs = new int[O];
-	vertices = new vertex[M];
+	int* outputs = e->outputs = new int[O];
+	vertex* vertices = e->vertices = (vertex*)allocate_memory((size_t)M * sizeof(vertex), "vertices");
+	if(vertices == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate " + to_string((size_t)M * sizeof(vertex)) + " bytes for the vertices.");
+	e->capacity = M;
+
+	// the structural hashing needs the polarities of the inputs of each vertex
+	unsigned char* polarities = NULL;
+	if(e->options.strash && !e->options.stream)
+	{
+		polarities = e->polarities = (unsigned char*)allocate_memory(M, "input polarities");
+		if(polarities == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the input polarities.");
+	}
 
 	// initialization of output list
 	for(int i = 0; i < O; i++) outputs[i] = -1;
@@ -57,24 +75,21 @@ void process_ascii_format(ifstream& input_file, int& M, int& I, int& L, int& O,
 		input_file.getline(buffer, sizeof(buffer));
 		if(strlen(buffer) < 1)
 		{
-			cerr << "The input file reached the end before expected." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The input file reached the end before expected.");
 		}
-		token = strtok(buffer, " ");
-		int label = atoi(token);
+		token = strtok_r(buffer, " ", &save);
+		int label = token != NULL ? atoi(token) : -1;
 
 		// integrity check #2
 		if(label < 0)
 		{
-			cerr << "The graph contains an invalid (negative) input index: " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The graph contains an invalid (negative) input index: " + to_string(label) + ".");
 		}
 
 		// integrity check #4
 		if(label != ((i+1)*2))
 		{
-			cerr << "The AIG format states that the label of an input must be twice its index, but the input with index " << i+1 << " has the label " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label of an input must be twice its index, but the input with index " + to_string(i+1) + " has the label " + to_string(label) + ".");
 		}
 
 		// if reached here, everything is OK, so set the value of the incoming edges
@@ -91,83 +106,78 @@ void process_ascii_format(ifstream& input_file, int& M, int& I, int& L, int& O,
 		input_file.getline(buffer, sizeof(buffer));
 		if(strlen(buffer) < 1)
 		{
-			cerr << "The input file reached the end before expected." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The input file reached the end before expected.");
 		}
-		token = strtok(buffer, " ");
-		int label = atoi(token);
+		token = strtok_r(buffer, " ", &save);
+		int label = token != NULL ? atoi(token) : -1;
 
 		// integrity check #5
-		if(label < 0)
+		if(label < 0 || (label >> 1) > M)
 		{
-			cerr << "The graph contains an invalid (negative) output index: " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The graph contains an invalid output index: " + to_string(label) + ".");
 		}
 
 		// integrity check #6
 		for(int j = 0; j < O; j++)
 			if(outputs[j] == label)
 			{
-				cerr << "The graph contains an output declared twice: " << label << "." << endl;
-				exit(-1);
+				return fail(e, PK_ERROR_FORMAT, "The graph contains an output declared twice: " + to_string(label) + ".");
 			}
 
 		// if reached here, everything is OK, so adds the label in the outputs list
 		outputs[i] = label;
 	}
 
+	if(e->graph_allocated != NULL)
+	{
+		e->graph_allocated(e);
+		if(e->error != PK_OK) return e->error;
+	}
+
 	// creates the vertices and its edges
 	for(int i = 0; i < A; i++)
 	{
 		input_file.getline(buffer, sizeof(buffer));
 		if(strlen(buffer) < 1)
 		{
-			cerr << "The input file reached the end before expected." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The input file reached the end before expected.");
 		}
-		token = strtok(buffer, " ");
-		int label = atoi(token);
+		token = strtok_r(buffer, " ", &save);
+		int label = token != NULL ? atoi(token) : -1;
 
 		// integrity check #7
 		if(label < 0)
 		{
-			cerr << "The graph contains an invalid (negative) vertex index: " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The graph contains an invalid (negative) vertex index: " + to_string(label) + ".");
 		}
 
 		// integrity check #8
 		if(label != ((i+I+1)*2))
 		{
-			cerr << "The AIG format states that the label of a vertex must be twice its index, but the vertex with index " << i+1 << " has the label " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label of a vertex must be twice its index, but the vertex with index " + to_string(i+1) + " has the label " + to_string(label) + ".");
 		}
-		token = strtok(NULL, " ");
-		int rhs0 = atoi(token);
-		token = strtok(NULL, " ");
-		int rhs1 = atoi(token);
+		char* rhs0_token = strtok_r(NULL, " ", &save);
+		char* rhs1_token = strtok_r(NULL, " ", &save);
+		if(rhs0_token == NULL || rhs1_token == NULL) return fail(e, PK_ERROR_FORMAT, "The vertex with the label " + to_string(label) + " has less than two inputs.");
+		int rhs0 = atoi(rhs0_token);
+		int rhs1 = atoi(rhs1_token);
 
 		// integrity check #9
 		if(rhs0 < rhs1)
 		{
-			cerr << "The AIG format states that the label of the first input of a vertex must be greater than the second." << endl;
-			cerr << "Found rhs0=" << rhs0 << " and rhs1=" << rhs1 << " for the label " << label << "." << endl;
-			exit(-1);			
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label of the first input of a vertex must be greater than the second. Found rhs0=" + to_string(rhs0) + " and rhs1=" + to_string(rhs1) + " for the label " + to_string(label) + ".");
 		}
 
 		// integrity check #10
 		if(rhs0 < 0 || rhs1 < 0)
 		{
-			cerr << "The vertex has an invalid value for its inputs." << endl;
-			cerr << "Found rhs0=" << rhs0 << " and rhs1=" << rhs1 << " for the label " << label << "." << endl;
-			exit(-1);			
+			return fail(e, PK_ERROR_FORMAT, "The vertex has an invalid value for its inputs. Found rhs0=" + to_string(rhs0) + " and rhs1=" + to_string(rhs1) + " for the label " + to_string(label) + ".");
 		}
 
 		// integrity check #11
 		if(label <= rhs0 || label <= rhs1)
 		{
-			cerr << "The AIG format states that the label must be greater than the value of its inputs." << endl;
-			cerr << "Found rhs0=" << rhs0 << " and rhs1=" << rhs1 << " for the label " << label << "." << endl;
-			exit(-1);			
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label must be greater than the value of its inputs. Found rhs0=" + to_string(rhs0) + " and rhs1=" + to_string(rhs1) + " for the label " + to_string(label) + ".");
 		}
 
 		// if reached here, everything is OK, so adds the vertex into in the list, creates its edges, and updates the fanout of the child vertices
@@ -181,41 +191,59 @@ void process_ascii_format(ifstream& input_file, int& M, int& I, int& L, int& O,
 		int rhs1_index = rhs1 >> 1;
 		if(rhs0 >= 2) vertices[rhs0_index-1].fanout += 1;
 		if(rhs1 >= 2) vertices[rhs1_index-1].fanout += 1;
+		if(polarities != NULL) polarities[i+I] = (rhs0 >= 2 ? rhs0 & 1 : 0) | (rhs1 >= 2 ? (rhs1 & 1) << 1 : 0);
+		if(e->vertex_decoded != NULL) e->vertex_decoded(e, i+I);
 
 	}
 	
-	// updates the fanout of the output vertices
+	// updates the fanout of the output vertices (constant outputs have none)
 	for(int i = 0; i < O; i++)
 	{
 		int output_index = outputs[i] >> 1;
-		vertices[output_index-1].fanout += 1;
+		if(output_index > 0) vertices[output_index-1].fanout += 1;
 	}
 
+	return PK_OK;
+
 }
 
 // process the file in the binary format
-void process_binary_format(ifstream& input_file, int& M, int& I, int& L, int& O, int& A, vertex*& vertices, int*& outputs)
+int process_binary_format(cut_engine* e, istream& input_file)
 {
+	int M = e->M;
+	int I = e->I;
+	int L = e->L;
+	int O = e->O;
+	int A = e->A;
 	char* token;
+	char* save;
 	char buffer[256];
 
 	// check for latches
 	if(L != 0)
 	{
-		cerr << "This graph contains latches. The current version of this implementation do not support them." << endl;
-		exit(-1);
+		return fail(e, PK_ERROR_UNSUPPORTED, "This graph contains latches. The current version of this implementation do not support them.");
 	}
 
 	// integrity check #1
 	if(M != I + L + A)
 	{
-		cerr << "This graph is invalid. M != I + L + A." << endl;
-		exit(-1);
+		return fail(e, PK_ERROR_FORMAT, "This graph is invalid. M != I + L + A.");
 	}
 
 	// OK. Now we're ready for memory allocation
-	outputs = new int[O];
-	vertices = new vertex[M];
+	int* outputs = e->outputs = new int[O];
+	vertex* vertices = e->vertices = (vertex*)allocate_memory((size_t)M * sizeof(vertex), "vertices");
+	if(vertices == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate " + to_string((size_t)M * sizeof(vertex)) + " bytes for the vertices.");
+	e->capacity = M;
+
+	// the structural hashing needs the polarities of the inputs of each vertex
+	unsigned char* polarities = NULL;
+	if(e->options.strash && !e->options.stream)
+	{
+		polarities = e->polarities = (unsigned char*)allocate_memory(M, "input polarities");
+		if(polarities == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the input polarities.");
+	}
 
 	// initialization of output list
 	for(int i = 0; i < O; i++) outputs[i] = -1;
@@ -235,37 +263,41 @@ void process_binary_format(ifstream& input_file, int& M, int& I, int& L, int& O,
 		input_file.getline(buffer, sizeof(buffer));
 		if(strlen(buffer) < 1)
 		{
-			cerr << "The input file reached the end before expected." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The input file reached the end before expected.");
 		}
-		token = strtok(buffer, " ");
-		int label = atoi(token);
+		token = strtok_r(buffer, " ", &save);
+		int label = token != NULL ? atoi(token) : -1;
 
 		// integrity check #5
-		if(label < 0)
+		if(label < 0 || (label >> 1) > M)
 		{
-			cerr << "The graph contains an invalid (negative) output index: " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The graph contains an invalid output index: " + to_string(label) + ".");
 		}
 
 		// integrity check #6
 		for(int j = 0; j < O; j++)
 			if(outputs[j] == label)
 			{
-				cerr << "The graph contains an output declared twice: " << label << "." << endl;
-				exit(-1);
+				return fail(e, PK_ERROR_FORMAT, "The graph contains an output declared twice: " + to_string(label) + ".");
 			}
 
 		// if reached here, everything is OK, so adds the label in the outputs list
 		outputs[i] = label;
 	}
 
+	if(e->graph_allocated != NULL)
+	{
+		e->graph_allocated(e);
+		if(e->error != PK_OK) return e->error;
+	}
+
 	// creates the vertices and its edges
 	for(int i = 0; i < A; i++)
 	{
 		
 		unsigned int delta0 = decode(input_file);
 		unsigned int delta1 = decode(input_file);
+		if(input_file.fail()) return fail(e, PK_ERROR_FORMAT, "*** decode: unexpected EOF");
 
 		int label = (I+i+1)*2;
 		int rhs0 = label - delta0;
@@ -274,39 +306,31 @@ void process_binary_format(ifstream& input_file, int& M, int& I, int& L, int& O,
 		// integrity check #7
 		if(label < 0)
 		{
-			cerr << "The graph contains an invalid (negative) vertex index: " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The graph contains an invalid (negative) vertex index: " + to_string(label) + ".");
 		}
 
 		// integrity check #8
 		if(label != ((i+I+1)*2))
 		{
-			cerr << "The AIG format states that the label of a vertex must be twice its index, but the vertex with index " << i+1 << " has the label " << label << "." << endl;
-			exit(-1);
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label of a vertex must be twice its index, but the vertex with index " + to_string(i+1) + " has the label " + to_string(label) + ".");
 		}
 
 		// integrity check #9
 		if(rhs0 < rhs1)
 		{
-			cerr << "The AIG format states that the label of the first input of a vertex must be greater than the second." << endl;
-			cerr << "Found rhs0=" << rhs0 << " and rhs1=" << rhs1 << " for the label " << label << "." << endl;
-			exit(-1);			
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label of the first input of a vertex must be greater than the second. Found rhs0=" + to_string(rhs0) + " and rhs1=" + to_string(rhs1) + " for the label " + to_string(label) + ".");
 		}
 
 		// integrity check #10
 		if(rhs0 < 0 || rhs1 < 0)
 		{
-			cerr << "The vertex has an invalid value for its inputs." << endl;
-			cerr << "Found rhs0=" << rhs0 << " and rhs1=" << rhs1 << " for the label " << label << "." << endl;
-			exit(-1);			
+			return fail(e, PK_ERROR_FORMAT, "The vertex has an invalid value for its inputs. Found rhs0=" + to_string(rhs0) + " and rhs1=" + to_string(rhs1) + " for the label " + to_string(label) + ".");
 		}
 
 		// integrity check #11
 		if(label <= rhs0 || label <= rhs1)
 		{
-			cerr << "The AIG format states that the label must be greater than the value of its inputs." << endl;
-			cerr << "Found rhs0=" << rhs0 << " and rhs1=" << rhs1 << " for the label " << label << "." << endl;
-			exit(-1);			
+			return fail(e, PK_ERROR_FORMAT, "The AIG format states that the label must be greater than the value of its inputs. Found rhs0=" + to_string(rhs0) + " and rhs1=" + to_string(rhs1) + " for the label " + to_string(label) + ".");
 		}
 
 		// if reached here, everything is OK, so adds the vertex into in the list, creates its edges, and updates the fanout of the child vertices
@@ -320,67 +344,98 @@ void process_binary_format(ifstream& input_file, int& M, int& I, int& L, int& O,
 		int rhs1_index = rhs1 >> 1;
 		if(rhs0 >= 2) vertices[rhs0_index-1].fanout += 1;
 		if(rhs1 >= 2) vertices[rhs1_index-1].fanout += 1;
+		if(polarities != NULL) polarities[i+I] = (rhs0 >= 2 ? rhs0 & 1 : 0) | (rhs1 >= 2 ? (rhs1 & 1) << 1 : 0);
+		if(e->vertex_decoded != NULL) e->vertex_decoded(e, i+I);
 
 	}
 	
-	// updates the fanout of the output vertices
+	// updates the fanout of the output vertices (constant outputs have none)
 	for(int i = 0; i < O; i++)
 	{
 		int output_index = outputs[i] >> 1;
-		vertices[output_index-1].fanout += 1;
+		if(output_index > 0) vertices[output_index-1].fanout += 1;
 	}
+
+	return PK_OK;
 }
 
-// creates the graph used by the main function
-void create_graph(char* filename, int& M, int& I, int& L, int& O, int& A, vertex*& vertices, int*& outputs)
+// builds the fanout lists of the vertices in the compressed sparse row format:
+// the AND vertices fed by the vertex i are fanout_targets[fanout_offsets[i]]
+// to fanout_targets[fanout_offsets[i+1]-1], in increasing order
+// (the outputs are not included; a vertex feeding both inputs of an AND
+// vertex appears twice in the list)
+int build_fanouts(cut_engine* e)
 {
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	int* fanout_offsets = e->fanout_offsets = (int*)allocate_memory((size_t)(M + 1) * sizeof(int), "fanout offsets");
+	if(fanout_offsets == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the fanout offsets.");
+
+	// counts the fanouts of each vertex
+	for(int i = I; i < M; i++)
+	{
+		if(vertices[i].left >= 0) fanout_offsets[vertices[i].left + 1]++;
+		if(vertices[i].right >= 0) fanout_offsets[vertices[i].right + 1]++;
+	}
+	for(int i = 0; i < M; i++) fanout_offsets[i + 1] += fanout_offsets[i];
 
-	// opens the input file
-	ifstream input_file;
-	input_file.open(filename, ios::binary | ios::in);
-
-	if(!input_file.is_open())
+	// fills the lists, using the offsets as insertion points and shifting
+	// them back at the end
+	int* fanout_targets = e->fanout_targets = (int*)allocate_memory((size_t)fanout_offsets[M] * sizeof(int), "fanout targets");
+	if(fanout_targets == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the fanout targets.");
+	for(int i = I; i < M; i++)
 	{
-		cerr << "Failed to open the input file." << endl;
-		exit(-1);
+		if(vertices[i].left >= 0) fanout_targets[fanout_offsets[vertices[i].left]++] = i;
+		if(vertices[i].right >= 0) fanout_targets[fanout_offsets[vertices[i].right]++] = i;
 	}
+	for(int i = M; i > 0; i--) fanout_offsets[i] = fanout_offsets[i - 1];
+	fanout_offsets[0] = 0;
+	return PK_OK;
+}
+
+// reads a graph in the AIGER format (binary or ASCII) into an engine
+int read_graph(cut_engine* e, istream& input_file)
+{
 
 	// process the 1st line
+	double start = begin_phase(e, PHASE_HEADER);
 	char buffer[256];
 	buffer[0] = '\0';
 	input_file.getline(buffer, sizeof(buffer));
 
 	// split into tokens, saving the values in variables
-	char* token = strtok(buffer," ");
-	token = strtok(NULL, " ");
-	M = atoi(token);
-	token = strtok(NULL, " ");
-	I = atoi(token);
-	token = strtok(NULL, " ");
-	L = atoi(token);
-	token = strtok(NULL, " ");
-	O = atoi(token);
-	token = strtok(NULL, " ");
-	A = atoi(token);
-
-	// file format check
-	if(strlen(buffer) > 2 && buffer[0] == 'a' && buffer[1] == 'a' && buffer[2] == 'g')
+	char* save;
+	int header[5];
+	char* token = strtok_r(buffer, " ", &save);
+	for(int i = 0; i < 5; i++)
 	{
-		cout << endl <<  "Processing AIG in the ASCII format..." << endl;
-		cout << "M I L O A = " << M << " " << I << " " << L
-			 << " " << O << " " << A << endl << endl;
-		process_ascii_format(input_file, M, I, L, O, A, vertices, outputs);
+		token = token != NULL ? strtok_r(NULL, " ", &save) : NULL;
+		header[i] = token != NULL ? atoi(token) : -1;
+		if(header[i] < 0) return fail(e, PK_ERROR_FORMAT, "Failed to process the input file. Wrong, invalid or unknown format.");
 	}
-	else if(strlen(buffer) > 2 && buffer[0] == 'a' && buffer[1] == 'i' && buffer[2] == 'g')
+	e->M = header[0];
+	e->I = header[1];
+	e->L = header[2];
+	e->O = header[3];
+	e->A = header[4];
+
+	// file format check
+	bool ascii = strlen(buffer) > 2 && buffer[0] == 'a' && buffer[1] == 'a' && buffer[2] == 'g';
+	bool binary = strlen(buffer) > 2 && buffer[0] == 'a' && buffer[1] == 'i' && buffer[2] == 'g';
+	if(!ascii && !binary)
+		return fail(e, PK_ERROR_FORMAT, "Failed to process the input file. Wrong, invalid or unknown format.");
+	if(e->verbose)
 	{
-		cout << endl << "Processing AIG in the binary format..." << endl;
-		cout << "M I L O A = " << M << " " << I << " " << L
-			 << " " << O << " " << A << endl << endl;
-		process_binary_format(input_file, M, I, L, O, A, vertices, outputs);
-	}
-	else {
-		cerr << "Failed to process the input file. Wrong, invalid or unknown format." << endl;
-		exit(-1);
+		cout << endl << "Processing AIG in the " << (ascii ? "ASCII" : "binary") << " format..." << endl;
+		cout << "M I L O A = " << e->M << " " << e->I << " " << e->L
+			 << " " << e->O << " " << e->A << endl << endl;
 	}
+	end_phase(e, PHASE_HEADER, start);
+
+	start = begin_phase(e, PHASE_DECODE);
+	int status = ascii ? process_ascii_format(e, input_file) : process_binary_format(e, input_file);
+	end_phase(e, PHASE_DECODE, start);
+	return status;
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,210 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "graph.h"
+#include "threadpool.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+double wall_time();
+cut_engine* create_engine(int k, int p);
+void destroy_engine(cut_engine* e);
+int load_file(cut_engine* e, const char* filename);
+int compute_cuts(cut_engine* e, bool display);
+int original_label(const cut_engine* e, int label);
+size_t cut_store_bytes(const cut_engine* e);
+void retain_memory(bool enabled);
+extern const char* phase_names[NUM_PHASES];
+
+// lists the files of a batch: the lines of a manifest (blank lines and lines
+// starting with # are skipped) or the AIGER files of a directory, by name
+int list_batch_files(cut_engine* e, const char* list, vector<string>& files)
+{
+	struct stat status;
+	if(stat(list, &status) != 0) return fail(e, PK_ERROR_OPEN, "Failed to open the batch list " + string(list) + ".");
+	if(S_ISDIR(status.st_mode))
+	{
+		DIR* directory = opendir(list);
+		if(directory == NULL) return fail(e, PK_ERROR_OPEN, "Failed to open the directory " + string(list) + ".");
+		struct dirent* entry;
+		while((entry = readdir(directory)) != NULL)
+		{
+			string name = entry->d_name;
+			if(name.size() > 4 && (name.compare(name.size() - 4, 4, ".aag") == 0 || name.compare(name.size() - 4, 4, ".aig") == 0))
+				files.push_back(string(list) + "/" + name);
+		}
+		closedir(directory);
+		sort(files.begin(), files.end());
+		return PK_OK;
+	}
+
+	ifstream manifest(list);
+	if(!manifest.is_open()) return fail(e, PK_ERROR_OPEN, "Failed to open the batch list " + string(list) + ".");
+	string line;
+	while(getline(manifest, line))
+	{
+		size_t first = line.find_first_not_of(" \t\r");
+		if(first == string::npos || line[first] == '#') continue;
+		size_t last = line.find_last_not_of(" \t\r");
+		files.push_back(line.substr(first, last - first + 1));
+	}
+	return PK_OK;
+}
+
+// creates an engine for the files of a batch with the options of the command
+// line (each file is evaluated by a single thread); the trace of the n-th
+// engine is written to the trace file followed by .n
+cut_engine* batch_engine(const cut_engine* e, int number)
+{
+	cut_engine* engine = create_engine(e->k, e->p);
+	engine->options = e->options;
+	engine->options.threads = 1;
+	engine->options.cone = e->options.cone != NULL ? strdup(e->options.cone) : NULL;
+	engine->options.cache = e->options.cache != NULL ? strdup(e->options.cache) : NULL;
+	engine->options.budget = e->options.budget != NULL ? strdup(e->options.budget) : NULL;
+	engine->options.trace = e->options.trace != NULL ? strdup((string(e->options.trace) + "." + to_string(number)).c_str()) : NULL;
+	return engine;
+}
+
+// returns a string quoted for JSON
+string quoted(const string& text)
+{
+	string result = "\"";
+	for(size_t i = 0; i < text.size(); i++)
+	{
+		if(text[i] == '"' || text[i] == '\\') result += '\\';
+		result += text[i];
+	}
+	return result + "\"";
+}
+
+// digest of the cuts of the evaluated vertices (FNV-1a over the label of each
+// vertex and the cost and the leaves of each of its cuts, with the labels of
+// the file), to compare the results of two runs
+unsigned long long cuts_digest(const cut_engine* e)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned long long prime = 1099511628211ULL;
+	for(int i = 0; i < e->M; i++)
+	{
+		if(e->vertices[i].winner == -1) continue;
+		hash = (hash ^ (unsigned)original_label(e, (i+1) << 1)) * prime;
+		const float* costs = &e->cut_costs[cost_start(e, i)];
+		const int* inputs = &e->cut_inputs[input_start(e, i)];
+		for(int j = 0; j < cut_slots(e, i); j++)
+		{
+			if(costs[j] == -1) continue;
+			unsigned bits;
+			memcpy(&bits, &costs[j], sizeof(bits));
+			hash = (hash ^ bits) * prime;
+			for(int l = 0; l < e->k; l++)
+				if(inputs[j*e->k + l] != -1) hash = (hash ^ (unsigned)original_label(e, inputs[j*e->k + l])) * prime;
+		}
+	}
+	return hash;
+}
+
+// evaluates the cuts of a file of a batch and describes the result as a JSON
+// line: the graph, the vertices evaluated, the time of loading, of
+// evaluating the cuts and of each phase, the size of the cut store and the
+// digest of the cuts (or the error)
+string evaluate_batch_file(cut_engine* e, const string& file, int& status)
+{
+	ostringstream line;
+	line.precision(9);
+	line << "{\"file\":" << quoted(file) << ",\"k\":" << e->k << ",\"p\":" << e->p;
+	double start = wall_time();
+	status = load_file(e, file.c_str());
+	double loaded = wall_time();
+	if(status == PK_OK) status = compute_cuts(e, false);
+	double end = wall_time();
+	if(status != PK_OK)
+	{
+		line << ",\"error\":" << quoted(e->message) << "}";
+		return line.str();
+	}
+
+	int evaluated = 0;
+	for(int i = e->I; i < e->M; i++) if(e->vertices[i].winner != -1) evaluated++;
+	char digest[32];
+	snprintf(digest, sizeof(digest), "%016llx", cuts_digest(e));
+	line << ",\"vertices\":" << e->M << ",\"inputs\":" << e->I << ",\"outputs\":" << e->O << ",\"ands\":" << e->A
+		 << ",\"evaluated\":" << evaluated << ",\"load\":" << loaded - start << ",\"compute\":" << end - loaded
+		 << ",\"total\":" << end - start << ",\"phases\":{";
+	for(int i = 0; i < NUM_PHASES; i++) line << (i > 0 ? "," : "") << "\"" << phase_names[i] << "\":" << e->phase_seconds[i];
+	line << "},\"cut_memory\":" << (e->cut_costs != NULL ? cut_store_bytes(e) : 0) << ",\"cuts\":\"" << digest << "\"}";
+	return line.str();
+}
+
+/* BATCH MODE
+ *
+ * Evaluates the cuts of many graphs in one process: the files of a manifest
+ * or of a directory are evaluated on a pool of threads, -t files at a time,
+ * each by a single thread. Each thread of the pool takes an idle engine, so
+ * an engine evaluates many files one after the other, and each thread keeps
+ * the mappings its engine releases for the next file (see retain_memory):
+ * after the first files, the graph and the cuts of a file take the memory of
+ * the previous one instead of mapping and faulting in new pages. The results
+ * file has one JSON line per file, in the order of the list, with the time of
+ * each file; a file that fails has its error in its line and does not stop
+ * the others.
+******************************************************************************/
+int run_batch(cut_engine* e, const char* list, const char* results_file)
+{
+	vector<string> files;
+	int status = list_batch_files(e, list, files);
+	if(status != PK_OK) return status;
+	ofstream output(results_file);
+	if(!output.is_open()) return fail(e, PK_ERROR_OPEN, "Failed to open the results file " + string(results_file) + ".");
+
+	double start = wall_time();
+	int threads = min(e->options.threads, max((int)files.size(), 1));
+	vector<string> lines(files.size());
+	vector<int> statuses(files.size(), PK_OK);
+	vector<cut_engine*> idle;
+	mutex idle_lock;
+	for(int t = 0; t < threads; t++) idle.push_back(batch_engine(e, t));
+	{
+		thread_pool pool(threads);
+		pool.parallel_for(0, files.size(), 1, [&](int first, int last) {
+			retain_memory(true);
+			cut_engine* engine;
+			{
+				lock_guard<mutex> lock(idle_lock);
+				engine = idle.back();
+				idle.pop_back();
+			}
+			for(int i = first; i < last; i++) lines[i] = evaluate_batch_file(engine, files[i], statuses[i]);
+			lock_guard<mutex> lock(idle_lock);
+			idle.push_back(engine);
+		});
+	}
+	for(int t = 0; t < threads; t++) destroy_engine(idle[t]);
+	retain_memory(false);
+
+	int failed = 0;
+	for(size_t i = 0; i < lines.size(); i++)
+	{
+		output << lines[i] << endl;
+		if(statuses[i] == PK_OK) continue;
+		if(failed++ == 0) status = statuses[i];
+	}
+	if(!output) return fail(e, PK_ERROR_OPEN, "Failed to write the results file " + string(results_file) + ".");
+	if(e->verbose)
+	{
+		char summary[256];
+		snprintf(summary, sizeof(summary), "%d files evaluated on %d threads in %.5f s (%d failed), results in %s.",
+			(int)files.size(), threads, wall_time() - start, failed, results_file);
+		cout << summary << endl;
+	}
+	if(failed > 0) return fail(e, status, to_string(failed) + " files of the batch failed (see " + string(results_file) + ").");
+	return PK_OK;
+}
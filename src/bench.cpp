@@ -0,0 +1,409 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <dirent.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+unsigned int decode(istream& input_file);
+int read_graph(cut_engine* e, istream& input_file);
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int winner_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset);
+int loser_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset);
+cut_engine* create_engine(int k, int p);
+void destroy_engine(cut_engine* e);
+void release_graph(cut_engine* e);
+int load_file(cut_engine* e, const char* filename);
+int compute_cuts(cut_engine* e, bool display);
+double wall_time();
+
+/* MICROBENCHMARKS
+ *
+ * Each benchmark is a function that runs a given number of operations. The
+ * number of operations of a repetition is calibrated first (doubled until a
+ * repetition takes at least the minimum time), one repetition is run to warm
+ * the caches, and then the repetitions are timed. The median time per
+ * operation is the figure to compare; the minimum, the mean, the standard
+ * deviation and the median absolute deviation tell how stable it was.
+ * The inputs are generated from fixed seeds, so every run measures the same
+ * work. The results go to the standard output as a JSON array and a summary
+ * goes to the standard error.
+******************************************************************************/
+
+// settings of a run
+typedef struct bs {
+	int repetitions;
+	double min_time;       // seconds per repetition
+	const char* filter;    // only the benchmarks whose names contain it (NULL: all)
+	const char* directory; // AIG files of the traversal benchmarks
+} bench_settings;
+
+// a benchmark: runs count operations and returns a value that depends on
+// them (so the compiler cannot drop the work)
+typedef struct bf {
+	string name;
+	string parameters;     // JSON members describing the input
+	long long (*run)(void* state, long long count);
+	void* state;
+} bench_function;
+
+// pseudo-random numbers (xorshift64*), deterministic from a seed
+inline unsigned long long next_random(unsigned long long& seed)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return seed * 2685821657736338717ULL;
+}
+
+volatile long long bench_sink;
+
+// times one repetition of count operations, in seconds
+double time_repetition(bench_function& f, long long count)
+{
+	double start = wall_time();
+	bench_sink += f.run(f.state, count);
+	return wall_time() - start;
+}
+
+// runs a benchmark and prints its results as a JSON object
+void run_benchmark(bench_function& f, const bench_settings& settings, bool& first)
+{
+	if(settings.filter != NULL && f.name.find(settings.filter) == string::npos) return;
+
+	long long count = 1;
+	while(time_repetition(f, count) < settings.min_time && count < (1LL << 40)) count *= 2;
+	time_repetition(f, count);
+	vector<double> times;
+	for(int r = 0; r < settings.repetitions; r++) times.push_back(time_repetition(f, count) * 1e9 / count);
+
+	sort(times.begin(), times.end());
+	int n = times.size();
+	double median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+	double mean = 0;
+	for(int r = 0; r < n; r++) mean += times[r];
+	mean /= n;
+	double variance = 0;
+	vector<double> deviations;
+	for(int r = 0; r < n; r++)
+	{
+		variance += (times[r] - mean) * (times[r] - mean);
+		deviations.push_back(fabs(times[r] - median));
+	}
+	double stddev = n > 1 ? sqrt(variance / (n - 1)) : 0;
+	sort(deviations.begin(), deviations.end());
+	double mad = n % 2 ? deviations[n / 2] : (deviations[n / 2 - 1] + deviations[n / 2]) / 2;
+
+	cout << (first ? "[\n" : ",\n") << "  {\"name\":\"" << f.name << "\"" << f.parameters
+		 << ",\"operations\":" << count << ",\"repetitions\":" << n
+		 << ",\"median_ns\":" << median << ",\"min_ns\":" << times[0] << ",\"mean_ns\":" << mean
+		 << ",\"stddev_ns\":" << stddev << ",\"mad_ns\":" << mad << "}";
+	first = false;
+	cerr << f.name << f.parameters << ": " << median << " ns/op (+/- " << mad << ")" << endl;
+}
+
+/* DECODING OF THE BINARY FORMAT
+******************************************************************************/
+
+// deltas of the binary format in a buffer, decoded over and over
+typedef struct ds {
+	string encoded;
+	int values;
+} decode_state;
+
+long long run_decode(void* state, long long count)
+{
+	decode_state* s = (decode_state*)state;
+	istringstream input(s->encoded);
+	long long sum = 0;
+	for(long long i = 0; i < count; i++)
+	{
+		if(i % s->values == 0)
+		{
+			input.clear();
+			input.seekg(0);
+		}
+		sum += decode(input);
+	}
+	return sum;
+}
+
+// encodes the deltas of an AND vertex like the AIGER writers: 7 bits per byte,
+// the high bit set on all bytes but the last
+void encode(string& buffer, unsigned x)
+{
+	while(x & ~0x7f)
+	{
+		buffer += (char)((x & 0x7f) | 0x80);
+		x >>= 7;
+	}
+	buffer += (char)x;
+}
+
+/* THE ASCII READER
+******************************************************************************/
+
+// an ASCII graph in memory, read over and over (one operation is the whole
+// graph, the time per line is the time divided by its lines)
+typedef struct as {
+	string text;
+	int lines;
+} ascii_state;
+
+long long run_ascii(void* state, long long count)
+{
+	ascii_state* s = (ascii_state*)state;
+	cut_engine* e = create_engine(4, 2);
+	long long sum = 0;
+	for(long long i = 0; i < count; i++)
+	{
+		istringstream input(s->text);
+		read_graph(e, input);
+		sum += e->vertices[e->M - 1].left;
+		release_graph(e);
+	}
+	destroy_engine(e);
+	return sum;
+}
+
+/* THE CUT KERNEL
+ *
+ * A vertex with two children whose p cuts have random costs and from k/2 to k
+ * leaves taken from a small pool, so that some products fit in k leaves and
+ * some do not, as in a real graph. Each call evaluates the cuts of the vertex
+ * again.
+******************************************************************************/
+
+typedef struct ks {
+	cut_engine* e;
+	vector<vertex> vertices;
+	vector<float> costs;
+	vector<int> inputs;
+} kernel_state;
+
+void create_kernel_state(kernel_state* s, int k, int p, unsigned long long seed)
+{
+	s->e = create_engine(k, p);
+	s->vertices.resize(3);
+	s->costs.assign(3 * p, -1);
+	s->inputs.assign(3 * p * k, -1);
+	for(int c = 0; c < 2; c++)
+	{
+		s->vertices[c].left = s->vertices[c].right = -1;
+		s->vertices[c].fanout = 1;
+		for(int j = 0; j < p; j++)
+		{
+			s->costs[c * p + j] = 1 + (next_random(seed) % 1000) / 100.0;
+			int leaves = k / 2 + next_random(seed) % (k - k / 2 + 1);
+			vector<int> cut;
+			while(cut.size() < leaves)
+			{
+				int leaf = (int)(4 + next_random(seed) % (2 * k)) * 2;
+				if(find(cut.begin(), cut.end(), leaf) == cut.end()) cut.push_back(leaf);
+			}
+			sort(cut.begin(), cut.end());
+			for(int l = 0; l < leaves; l++) s->inputs[(c * p + j) * k + l] = cut[l];
+		}
+	}
+	s->vertices[2].left = 0;
+	s->vertices[2].right = 1;
+	s->vertices[2].fanout = 2;
+	s->e->vertices = &s->vertices[0];
+	s->e->cut_costs = &s->costs[0];
+	s->e->cut_inputs = &s->inputs[0];
+	s->e->cost_offset = p;
+	s->e->input_offset = p * k;
+	s->e->M = 3;
+}
+
+long long run_kernel(void* state, long long count)
+{
+	kernel_state* s = (kernel_state*)state;
+	long long sum = 0;
+	for(long long i = 0; i < count; i++) sum += compute_kcuts(s->e, 2, 0, 1);
+	return sum;
+}
+
+/* WINNER AND LOSER CUTS
+******************************************************************************/
+
+// lists of p random costs (with some empty positions), scanned in turn
+typedef struct ws {
+	int p;
+	int lists;
+	vector<float> costs;
+} winner_state;
+
+long long run_winner(void* state, long long count)
+{
+	winner_state* s = (winner_state*)state;
+	long long sum = 0;
+	for(long long i = 0; i < count; i++) sum += winner_cut(i % s->lists, &s->costs[0], s->p, s->p);
+	return sum;
+}
+
+long long run_loser(void* state, long long count)
+{
+	winner_state* s = (winner_state*)state;
+	long long sum = 0;
+	for(long long i = 0; i < count; i++) sum += loser_cut(i % s->lists, &s->costs[0], s->p, s->p);
+	return sum;
+}
+
+/* FULL TRAVERSAL OF A FILE
+ * One operation is the evaluation of all the cuts of the graph, already in
+ * memory, with the default engine (the cut store is allocated again each
+ * time, as in a run).
+******************************************************************************/
+
+long long run_traversal(void* state, long long count)
+{
+	cut_engine* e = (cut_engine*)state;
+	long long sum = 0;
+	for(long long i = 0; i < count; i++)
+	{
+		compute_cuts(e, false);
+		sum += e->vertices[e->M - 1].winner;
+	}
+	return sum;
+}
+
+// shows the help on screen
+void show_bench_help(char* argv[])
+{
+	cerr << endl << "  \e[1mUsage:\e[0m " << argv[0] << " [options]" << endl << endl;
+	cerr << "  -r <n>         Timed repetitions of each benchmark (default 15)." << endl;
+	cerr << "  -m <ms>        Minimum time of a repetition, in milliseconds (default 20)." << endl;
+	cerr << "  -f <text>      Run only the benchmarks whose names contain the text." << endl;
+	cerr << "  -a <dir>       Directory of the AIG files of the traversal benchmarks" << endl;
+	cerr << "                 (default aiger)." << endl << endl;
+}
+
+/* MAIN FUNCTION: RUNS THE MICROBENCHMARKS
+******************************************************************************/
+int main(int argc, char* argv[])
+{
+	bench_settings settings;
+	settings.repetitions = 15;
+	settings.min_time = 0.02;
+	settings.filter = NULL;
+	settings.directory = "aiger";
+	for(int i = 1; i < argc; i++)
+	{
+		if(i + 1 < argc && strcmp(argv[i], "-r") == 0) settings.repetitions = atoi(argv[++i]);
+		else if(i + 1 < argc && strcmp(argv[i], "-m") == 0) settings.min_time = atof(argv[++i]) / 1000.0;
+		else if(i + 1 < argc && strcmp(argv[i], "-f") == 0) settings.filter = argv[++i];
+		else if(i + 1 < argc && strcmp(argv[i], "-a") == 0) settings.directory = argv[++i];
+		else
+		{
+			show_bench_help(argv);
+			return -1;
+		}
+	}
+	if(settings.repetitions < 1 || settings.min_time <= 0)
+	{
+		cerr << "FAIL. Minimal values for -r and -m are 1 and more than 0." << endl;
+		return -1;
+	}
+	bool first = true;
+
+	// decoding: deltas of the sizes found in real files, mostly one or two bytes
+	decode_state decoding;
+	unsigned long long seed = 1;
+	decoding.values = 1 << 16;
+	for(int i = 0; i < decoding.values; i++)
+	{
+		unsigned long long r = next_random(seed);
+		encode(decoding.encoded, r % 8 == 0 ? r % 100000 : r % 8 < 3 ? r % 16384 : r % 128);
+	}
+	bench_function decode_bench = {"decode", ",\"values\":" + to_string(decoding.values), run_decode, &decoding};
+	run_benchmark(decode_bench, settings, first);
+
+	// the ASCII reader over a graph of AND vertices with random children
+	ascii_state ascii;
+	int I = 64;
+	int A = 1 << 14;
+	ascii.lines = I + 1 + A;
+	ostringstream text;
+	text << "aag " << I + A << " " << I << " 0 1 " << A << "\n";
+	for(int i = 0; i < I; i++) text << (i + 1) * 2 << "\n";
+	text << (I + A) * 2 << "\n";
+	for(int i = 0; i < A; i++)
+	{
+		int label = (I + i + 1) * 2;
+		int variable0 = 1 + next_random(seed) % (label / 2 - 1);
+		int variable1 = 1 + next_random(seed) % variable0;
+		int rhs0 = variable0 * 2 + (next_random(seed) & 1);
+		int rhs1 = variable1 == variable0 ? rhs0 : variable1 * 2 + (next_random(seed) & 1);
+		text << label << " " << rhs0 << " " << rhs1 << "\n";
+	}
+	ascii.text = text.str();
+	bench_function ascii_bench = {"ascii_reader", ",\"lines\":" + to_string(ascii.lines), run_ascii, &ascii};
+	run_benchmark(ascii_bench, settings, first);
+
+	// the cut kernel and the winner and loser cuts for several (k, p)
+	int ks[] = {4, 6, 8};
+	int ps[] = {2, 4, 8, 12};
+	for(int a = 0; a < 3; a++)
+		for(int b = 0; b < 4; b++)
+		{
+			kernel_state kernel;
+			create_kernel_state(&kernel, ks[a], ps[b], 7 + a * 4 + b);
+			bench_function kernel_bench = {"compute_kcuts", ",\"k\":" + to_string(ks[a]) + ",\"p\":" + to_string(ps[b]), run_kernel, &kernel};
+			run_benchmark(kernel_bench, settings, first);
+			kernel.e->vertices = NULL;
+			kernel.e->cut_costs = NULL;
+			kernel.e->cut_inputs = NULL;
+			destroy_engine(kernel.e);
+		}
+	for(int b = 0; b < 4; b++)
+	{
+		winner_state winners;
+		winners.p = ps[b];
+		winners.lists = 4096;
+		for(int i = 0; i < winners.lists * winners.p; i++)
+			winners.costs.push_back(next_random(seed) % 5 == 0 ? -1 : (next_random(seed) % 1000) / 100.0);
+		bench_function winner_bench = {"winner_cut", ",\"p\":" + to_string(ps[b]), run_winner, &winners};
+		bench_function loser_bench = {"loser_cut", ",\"p\":" + to_string(ps[b]), run_loser, &winners};
+		run_benchmark(winner_bench, settings, first);
+		run_benchmark(loser_bench, settings, first);
+	}
+
+	// the full traversal of each file of the directory
+	vector<string> files;
+	DIR* directory = opendir(settings.directory);
+	if(directory != NULL)
+	{
+		struct dirent* entry;
+		while((entry = readdir(directory)) != NULL)
+		{
+			string name = entry->d_name;
+			if(name.size() > 4 && (name.substr(name.size() - 4) == ".aag" || name.substr(name.size() - 4) == ".aig"))
+				files.push_back(string(settings.directory) + "/" + name);
+		}
+		closedir(directory);
+	}
+	sort(files.begin(), files.end());
+	for(int i = 0; i < files.size(); i++)
+	{
+		cut_engine* e = create_engine(4, 2);
+		if(load_file(e, files[i].c_str()) != PK_OK)
+		{
+			cerr << files[i] << ": " << e->message << endl;
+			destroy_engine(e);
+			continue;
+		}
+		bench_function traversal_bench = {"traversal", ",\"file\":\"" + files[i] + "\",\"vertices\":" + to_string(e->M), run_traversal, e};
+		run_benchmark(traversal_bench, settings, first);
+		destroy_engine(e);
+	}
+
+	cout << (first ? "[" : "") << "\n]" << endl;
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+
+// reads the value of --budget: a number of bytes, with an optional K, M or G
+// suffix (powers of 1024), or a percentage of the store with p cuts per
+// vertex ("40%"); returns false if the value is not one of those
+bool parse_budget(const char* value, double& bytes, double& percent)
+{
+	bytes = 0;
+	percent = 0;
+	if(value == NULL) return false;
+	char* end;
+	double amount = strtod(value, &end);
+	if(end == value || amount <= 0) return false;
+	string suffix = end;
+	if(suffix == "%") percent = amount;
+	else if(suffix == "" || suffix == "B") bytes = amount;
+	else if(suffix == "K" || suffix == "KB") bytes = amount * 1024.0;
+	else if(suffix == "M" || suffix == "MB") bytes = amount * 1024.0 * 1024.0;
+	else if(suffix == "G" || suffix == "GB") bytes = amount * 1024.0 * 1024.0 * 1024.0;
+	else return false;
+	return true;
+}
+
+// the cut store has an adaptive budget (only the split layout, outside the
+// streaming mode, whose fanouts are not known when the store is allocated)
+bool adaptive_budget(const cut_engine* e)
+{
+	return e->options.budget != NULL && e->options.layout == LAYOUT_SPLIT && !e->options.stream;
+}
+
+// weight of an AND vertex in the share of the budget (see below)
+inline double slot_weight(int fanout, int level, int max_level)
+{
+	return (1.0 + 1.0 / fanout) * (1.0 + (double)(max_level - level) / max_level);
+}
+
+/* ADAPTIVE CUT BUDGET
+ *
+ * Instead of p cuts for every vertex, the store gets a number of cuts (slots)
+ * from the budget, and each vertex gets its own share of it. An input needs a
+ * single slot (its only cut) and an AND vertex without fanout none (it is
+ * never evaluated). An AND vertex with fanout gets at least 2 slots, room for
+ * a product and its autocut, and at most its bound: a vertex never keeps more
+ * cuts than the products of the cuts of its children plus the autocut, and
+ * its cuts fill the first positions of its list, so with p cuts per vertex
+ * the positions past min(p, bound(left) * bound(right) + 1) stay empty (a
+ * constant child counts as p cuts, an input as 1). These bounds alone save
+ * the shallow levels of the graph without changing any cut.
+ * The slots left are shared by weight, from the fanout and the level of the
+ * vertex: the costs of the cuts of a vertex are divided by its fanout, so a
+ * vertex of high fanout ranks its products with small costs whatever it keeps,
+ * while the cut list of a vertex of fanout 1 in a chain is the only choice
+ * its parent gets; and the cuts of a shallow vertex reach more vertices above
+ * it. The weight goes from 1 (high fanout, deepest level) to 4 (fanout 1,
+ * level 1), and a vertex of weight w gets min(bound - 2, floor(s * w)) extra
+ * slots, with the highest scale s that keeps the total within the budget
+ * (found by bisection). The cuts of vertex i then take the positions from
+ * cut_offsets[i] to cut_offsets[i+1] of the costs (times k for the inputs).
+ * The M+1 offsets are part of the budget: the slots get what they leave.
+ * Returns PK_OK, PK_ERROR_ARGUMENT if the budget is below the minimum or
+ * PK_ERROR_MEMORY.
+******************************************************************************/
+int allocate_adaptive_store(cut_engine* e)
+{
+	int M = e->M;
+	int I = e->I;
+	int p = e->p;
+	int k = e->k;
+	vertex* vertices = e->vertices;
+	size_t slot_bytes = sizeof(float) + k * sizeof(int);
+	size_t offset_bytes = (size_t)(M + 1) * sizeof(long);
+	double bytes, percent;
+	parse_budget(e->options.budget, bytes, percent);
+	if(percent > 0) bytes = (double)M * p * slot_bytes * percent / 100.0;
+	double budget = (bytes - offset_bytes) / slot_bytes;
+
+	// the level and the bound of each vertex, and the minimum number of slots
+	int* level = (int*)allocate_memory((size_t)M * sizeof(int), "levels");
+	int* bound = (int*)allocate_memory((size_t)M * sizeof(int), "cut bounds");
+	e->cut_offsets = (long*)allocate_memory((size_t)(M + 1) * sizeof(long), "cut offsets");
+	if(level == NULL || bound == NULL || e->cut_offsets == NULL)
+	{
+		free_memory(level);
+		free_memory(bound);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the cut offsets.");
+	}
+	int max_level = 1;
+	long long minimum = I;
+	for(int i = 0; i < I; i++)
+	{
+		level[i] = 0;
+		bound[i] = 1;
+	}
+	for(int i = I; i < M; i++)
+	{
+		int left_index = vertices[i].left;
+		int right_index = vertices[i].right;
+		int left_level = left_index >= 0 ? level[left_index] : 0;
+		int right_level = right_index >= 0 ? level[right_index] : 0;
+		level[i] = (left_level > right_level ? left_level : right_level) + 1;
+		if(level[i] > max_level) max_level = level[i];
+		long long products = (long long)(left_index >= 0 ? bound[left_index] : p) * (right_index >= 0 ? bound[right_index] : p);
+		bound[i] = products + 1 < p ? products + 1 : p;
+		if(vertices[i].fanout > 0) minimum += 2;
+	}
+	if(budget < minimum)
+	{
+		free_memory(level);
+		free_memory(bound);
+		free_memory(e->cut_offsets);
+		e->cut_offsets = NULL;
+		return fail(e, PK_ERROR_ARGUMENT, "The budget of the cuts is below the " + to_string((size_t)minimum * slot_bytes + offset_bytes)
+			+ " bytes of 2 cuts per vertex and the offsets of the cut lists.");
+	}
+
+	// the highest scale whose extra slots fit in the budget (a weight is at
+	// least 1, so with a scale of p - 2 every vertex gets its bound)
+	double low = 0;
+	double high = p - 2;
+	for(int round = 0; round <= 40; round++)
+	{
+		double scale = round == 0 ? high : (low + high) / 2;
+		long long extra = 0;
+		for(int i = I; i < M; i++)
+		{
+			if(vertices[i].fanout == 0) continue;
+			double slots = scale * slot_weight(vertices[i].fanout, level[i], max_level);
+			extra += slots < bound[i] - 2 ? (long long)slots : bound[i] - 2;
+		}
+		if(minimum + extra <= budget) low = scale;
+		else high = scale;
+		if(round == 0 && low == high) break;
+	}
+
+	// the positions of the cut lists
+	long* cut_offsets = e->cut_offsets;
+	int full = 0;
+	cut_offsets[0] = 0;
+	for(int i = 0; i < M; i++)
+	{
+		int slots = 1;
+		if(i >= I && vertices[i].fanout == 0) slots = 0;
+		else if(i >= I)
+		{
+			double extra = low * slot_weight(vertices[i].fanout, level[i], max_level);
+			slots = 2 + (extra < bound[i] - 2 ? (int)extra : bound[i] - 2);
+			if(slots == bound[i]) full++;
+		}
+		cut_offsets[i + 1] = cut_offsets[i] + slots;
+	}
+	free_memory(level);
+	free_memory(bound);
+
+	size_t total = cut_offsets[M];
+	e->cost_offset = p;
+	e->input_offset = p * k;
+	e->cut_costs = (float*)allocate_memory(total * sizeof(float), "cut costs");
+	e->cut_inputs = (int*)allocate_memory(total * k * sizeof(int), "cut inputs");
+	if(e->cut_costs == NULL || e->cut_inputs == NULL)
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate " + to_string(total * slot_bytes) + " bytes for the cuts.");
+	e->cut_rows = M;
+
+	if(e->verbose)
+		cout << "Adaptive cut budget: " << total << " cuts (" << total * slot_bytes << " bytes, "
+			 << total * 100 / ((size_t)M * p) << "% of " << p << " cuts per vertex), " << full << " of "
+			 << M - I << " AND vertices with all the cuts they can have." << endl;
+	return PK_OK;
+}
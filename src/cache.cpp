@@ -0,0 +1,242 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int allocate_cut_store(cut_engine* e);
+void release_cuts(cut_engine* e);
+void* map_file(int fd, size_t offset, size_t bytes, const char* name);
+void free_memory(void* address);
+void* allocate_memory(size_t bytes, const char* name);
+int mark_fanin(cut_engine* e, unsigned char* in_cone, bool unevaluated_only);
+
+// first bytes of a cache file
+#define CACHE_MAGIC "PKCUTS"
+
+/* CACHE FILES
+ *
+ * One file per graph and (k, p), named after the hash of the graph, k, p and
+ * the version of the files. After the header come three sections, each one
+ * starting at a page boundary so it can be mapped on its own: the p costs of
+ * each vertex, the p*k inputs of each vertex (the split layout), and the
+ * position of the winner cut of each vertex (-1 if the vertex has no cuts).
+ * Only the vertices the outputs reach have cuts in a file, whatever the
+ * engine that wrote it evaluated, so a hit shows the same vertices as a run
+ * of any engine on the graph.
+******************************************************************************/
+typedef struct ch {
+	char magic[8];
+	int version;
+	int k;
+	int p;
+	int M;
+	int I;
+	unsigned long long hash;
+	unsigned long long costs_offset;
+	unsigned long long inputs_offset;
+	unsigned long long winners_offset;
+} cache_header;
+
+// hashes (FNV-1a) everything the cuts depend on: the sizes, the children and
+// the fanout of each vertex and the outputs
+unsigned long long hash_graph(const cut_engine* e)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned long long prime = 1099511628211ULL;
+	int sizes[3] = {e->M, e->I, e->O};
+	for(int i = 0; i < 3; i++) hash = (hash ^ (unsigned)sizes[i]) * prime;
+	for(int i = 0; i < e->M; i++)
+	{
+		hash = (hash ^ (unsigned)e->vertices[i].left) * prime;
+		hash = (hash ^ (unsigned)e->vertices[i].right) * prime;
+		hash = (hash ^ (unsigned)e->vertices[i].fanout) * prime;
+	}
+	for(int i = 0; i < e->O; i++) hash = (hash ^ (unsigned)e->outputs[i]) * prime;
+	return hash;
+}
+
+// name of the cache file of a graph
+string cache_path(const cut_engine* e, unsigned long long hash)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx-k%d-p%d-v%d.cuts", hash, e->k, e->p, CACHE_VERSION);
+	return string(e->options.cache) + "/" + name;
+}
+
+// fills the header of the cache file of a graph, placing the sections
+void cache_layout(const cut_engine* e, unsigned long long hash, cache_header& header)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, CACHE_MAGIC);
+	header.version = CACHE_VERSION;
+	header.k = e->k;
+	header.p = e->p;
+	header.M = e->M;
+	header.I = e->I;
+	header.hash = hash;
+	header.costs_offset = page;
+	header.inputs_offset = header.costs_offset + ((size_t)e->M * e->p * sizeof(float) + page - 1) / page * page;
+	header.winners_offset = header.inputs_offset + ((size_t)e->M * e->p * e->k * sizeof(int) + page - 1) / page * page;
+}
+
+/* LOADS THE CUTS OF A GRAPH FROM THE CACHE
+ * With the split layout the sections of the file become the cut store (as
+ * private pages, so later edits of the graph do not change the file); with
+ * the aos layout they are copied into the records.
+ * Returns true if the cuts were found; a missing, truncated or foreign file
+ * is a miss.
+******************************************************************************/
+bool load_cached_cuts(cut_engine* e, unsigned long long hash)
+{
+	string path = cache_path(e, hash);
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) return false;
+
+	cache_header expected, header;
+	cache_layout(e, hash, expected);
+	struct stat status;
+	if(pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(&header, &expected, sizeof(header)) != 0
+	   || fstat(fd, &status) != 0 || (size_t)status.st_size < header.winners_offset + (size_t)e->M * sizeof(int))
+	{
+		close(fd);
+		return false;
+	}
+
+	int M = e->M;
+	int p = e->p;
+	int k = e->k;
+	release_cuts(e);
+	float* costs = (float*)map_file(fd, header.costs_offset, (size_t)M * p * sizeof(float), "cut costs");
+	int* inputs = (int*)map_file(fd, header.inputs_offset, (size_t)M * p * k * sizeof(int), "cut inputs");
+	int* winners = (int*)map_file(fd, header.winners_offset, (size_t)M * sizeof(int), "cached winners");
+	close(fd);
+	bool found = costs != NULL && inputs != NULL && winners != NULL;
+
+	if(found && e->options.layout == LAYOUT_SPLIT)
+	{
+		e->cut_costs = costs;
+		e->cut_inputs = inputs;
+		e->cost_offset = p;
+		e->input_offset = p * k;
+		e->cut_rows = M;
+		costs = NULL;
+		inputs = NULL;
+	}
+	else if(found)
+	{
+		found = allocate_cut_store(e) == PK_OK;
+		for(int i = 0; i < M && found; i++)
+		{
+			memcpy(&e->cut_costs[(size_t)i * e->cost_offset], &costs[(size_t)i * p], p * sizeof(float));
+			memcpy(&e->cut_inputs[(size_t)i * e->input_offset], &inputs[(size_t)i * p * k], p * k * sizeof(int));
+		}
+	}
+	if(found)
+	{
+		for(int i = 0; i < e->I; i++) e->vertices[i].winner = i;
+		for(int i = e->I; i < M; i++) e->vertices[i].winner = winners[i] == -1 ? -1 : i * e->cost_offset + winners[i];
+	}
+	else release_cuts(e);
+	free_memory(winners);
+	free_memory(inputs);
+	free_memory(costs);
+
+	if(found && e->verbose) cout << "Loaded the cuts from the cache file " << path << "." << endl;
+	return found;
+}
+
+// writes a section of a cache file
+bool write_section(int fd, const void* data, size_t bytes, size_t offset)
+{
+	const char* next = (const char*)data;
+	while(bytes > 0)
+	{
+		ssize_t written = pwrite(fd, next, bytes, offset);
+		if(written <= 0) return false;
+		next += written;
+		offset += written;
+		bytes -= written;
+	}
+	return true;
+}
+
+/* SAVES THE CUTS OF A GRAPH IN THE CACHE
+ * The file is written under a temporary name and renamed, so a file with the
+ * final name is always complete, even with several runs writing the same
+ * file. A failure to write only leaves the cache without the file.
+******************************************************************************/
+void store_cuts(cut_engine* e, unsigned long long hash)
+{
+	string path = cache_path(e, hash);
+	unsigned char* in_cone = (unsigned char*)allocate_memory(e->M, "cone marks");
+	if(in_cone == NULL)
+	{
+		if(e->verbose) cout << "Failed to write the cache file " << path << "." << endl;
+		return;
+	}
+	mark_fanin(e, in_cone, false);
+	string temporary = path + "." + to_string(getpid()) + "." + to_string((uintptr_t)e) + ".tmp";
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+	{
+		free_memory(in_cone);
+		if(e->verbose) cout << "Failed to create the cache file " << path << "." << endl;
+		return;
+	}
+
+	int M = e->M;
+	int p = e->p;
+	int k = e->k;
+	cache_header header;
+	cache_layout(e, hash, header);
+	bool written = write_section(fd, &header, sizeof(header), 0);
+
+	// the cuts in the split layout and the winners as positions in the cut
+	// lists, a block of vertices at a time (no cuts outside the cone)
+	const int block = 4096;
+	vector<float> costs((size_t)block * p);
+	vector<int> inputs((size_t)block * p * k);
+	vector<int> winners(block);
+	for(int i = 0; i < M && written; i += block)
+	{
+		int count = M - i < block ? M - i : block;
+		for(int j = 0; j < count; j++)
+		{
+			int vertex_index = i + j;
+			int winner = e->vertices[vertex_index].winner;
+			if(vertex_index >= e->I && !in_cone[vertex_index])
+			{
+				fill(costs.begin() + (size_t)j * p, costs.begin() + (size_t)(j + 1) * p, -1.0f);
+				fill(inputs.begin() + (size_t)j * p * k, inputs.begin() + (size_t)(j + 1) * p * k, -1);
+				winners[j] = -1;
+				continue;
+			}
+			memcpy(&costs[(size_t)j * p], &e->cut_costs[(size_t)vertex_index * e->cost_offset], p * sizeof(float));
+			memcpy(&inputs[(size_t)j * p * k], &e->cut_inputs[(size_t)vertex_index * e->input_offset], p * k * sizeof(int));
+			winners[j] = winner == -1 || vertex_index < e->I ? winner : winner - vertex_index * e->cost_offset;
+		}
+		written = write_section(fd, &costs[0], (size_t)count * p * sizeof(float), header.costs_offset + (size_t)i * p * sizeof(float))
+			   && write_section(fd, &inputs[0], (size_t)count * p * k * sizeof(int), header.inputs_offset + (size_t)i * p * k * sizeof(int))
+			   && write_section(fd, &winners[0], count * sizeof(int), header.winners_offset + (size_t)i * sizeof(int));
+	}
+
+	free_memory(in_cone);
+	written = close(fd) == 0 && written;
+	if(written && rename(temporary.c_str(), path.c_str()) == 0)
+	{
+		if(e->verbose) cout << "Saved the cuts in the cache file " << path << "." << endl;
+		return;
+	}
+	unlink(temporary.c_str());
+	if(e->verbose) cout << "Failed to write the cache file " << path << "." << endl;
+}
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <vector>
+#include "graph.h"
+#include "threadpool.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int mark_cone(cut_engine* e, unsigned char* in_cone);
+int initialize_cuts(cut_engine* e);
+void print_graph_cuts(cut_engine* e);
+size_t cut_store_bytes(const cut_engine* e);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+double wall_time();
+double begin_phase(cut_engine* e, int phase);
+void end_phase(cut_engine* e, int phase, double start);
+
+// cut store of one configuration of a sweep
+typedef struct cs {
+	int k;
+	int p;
+	float* cut_costs;
+	int* cut_inputs;
+	int cost_offset;
+	int input_offset;
+	int cut_rows;
+} cut_store;
+
+// moves the cut store of an engine to a store of the sweep
+void take_store(cut_engine* e, cut_store& store)
+{
+	store.k = e->k;
+	store.p = e->p;
+	store.cut_costs = e->cut_costs;
+	store.cut_inputs = e->cut_inputs;
+	store.cost_offset = e->cost_offset;
+	store.input_offset = e->input_offset;
+	store.cut_rows = e->cut_rows;
+	e->cut_costs = NULL;
+	e->cut_inputs = NULL;
+	e->cut_rows = 0;
+}
+
+// makes a store of the sweep the cut store of an engine (or of a view of it)
+void use_store(cut_engine* e, const cut_store& store)
+{
+	e->k = store.k;
+	e->p = store.p;
+	e->cut_costs = store.cut_costs;
+	e->cut_inputs = store.cut_inputs;
+	e->cost_offset = store.cost_offset;
+	e->input_offset = store.input_offset;
+	e->cut_rows = store.cut_rows;
+}
+
+void free_store(cut_store& store)
+{
+	free_memory(store.cut_costs);
+	free_memory(store.cut_inputs);
+	store.cut_costs = NULL;
+	store.cut_inputs = NULL;
+}
+
+/* SWEEP OF (K, P) CONFIGURATIONS
+ *
+ * The graph is loaded once and the cone of the outputs is marked once,
+ * recording the vertices to evaluate in index order (children first). Every
+ * configuration gets its own cut store, all of them allocated at the start
+ * and kept to the end, and a single pass over that order evaluates each
+ * vertex for every configuration in turn, so the graph and the order are
+ * read once for all of them. With several threads, the configurations are
+ * dealt in blocks and each thread makes the pass for its block, with its own
+ * view of the engine. The results of each configuration are the same as a
+ * separate run with its values of k and p. At the end the engine keeps the
+ * cuts of the last configuration, and the other stores are released.
+ * The configurations are evaluated as with the dfs engine: another engine, a
+ * cache, the reuse of cuts or an adaptive budget are rejected.
+******************************************************************************/
+int evaluate_configurations(cut_engine* e, bool display)
+{
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	run_options& options = e->options;
+	unsigned char* in_cone = (unsigned char*)allocate_memory(M, "cone marks");
+	if(in_cone == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the cone marks.");
+	int count = mark_cone(e, in_cone);
+	int* order = (int*)allocate_memory((size_t)count * sizeof(int), "evaluation order");
+	if(order == NULL)
+	{
+		free_memory(in_cone);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the evaluation order.");
+	}
+	int next = 0;
+	for(int i = I; i < M; i++) if(in_cone[i]) order[next++] = i;
+	free_memory(in_cone);
+
+	// the stores of all the configurations
+	int configurations = options.num_ks * options.num_ps;
+	vector<cut_store> stores;
+	double start = begin_phase(e, PHASE_INIT);
+	int status = PK_OK;
+	for(int a = 0; a < options.num_ks && status == PK_OK; a++)
+		for(int b = 0; b < options.num_ps && status == PK_OK; b++)
+		{
+			e->k = options.ks[a];
+			e->p = options.ps[b];
+			status = initialize_cuts(e);
+			if(status != PK_OK) break;
+			stores.push_back(cut_store());
+			take_store(e, stores.back());
+		}
+	end_phase(e, PHASE_INIT, start);
+	if(status != PK_OK)
+	{
+		for(size_t c = 0; c < stores.size(); c++) free_store(stores[c]);
+		free_memory(order);
+		return status;
+	}
+
+	// one pass over the order per block of configurations; only the block of
+	// the last configuration sets the winners, which the engine keeps
+	int threads = options.threads < configurations ? options.threads : configurations;
+	if(e->verbose) cout << "Sweeping " << configurations << " configurations over " << count << " vertices on " << threads << " thread" << (threads > 1 ? "s" : "") << ":" << endl;
+	start = begin_phase(e, PHASE_ENUMERATION);
+	{
+		thread_pool pool(threads);
+		pool.parallel_for(0, configurations, (configurations + threads - 1) / threads, [&](int first, int last) {
+			vector<cut_engine> views(last - first, *e);
+			for(int c = first; c < last; c++) use_store(&views[c - first], stores[c]);
+			bool winners = last == configurations;
+			for(int j = 0; j < count; j++)
+			{
+				int vertex_index = order[j];
+				vertex* v = &vertices[vertex_index];
+				int winner = -1;
+				for(int c = first; c < last; c++) winner = compute_kcuts(&views[c - first], vertex_index, v->left, v->right);
+				if(winners) v->winner = winner;
+			}
+		});
+	}
+	end_phase(e, PHASE_ENUMERATION, start);
+	double end = wall_time();
+
+	size_t total_bytes = 0;
+	for(int c = 0; c < configurations; c++)
+	{
+		use_store(e, stores[c]);
+		size_t bytes = cut_store_bytes(e);
+		total_bytes += bytes;
+		if(e->verbose) cout << "  k=" << e->k << " p=" << e->p << ": " << bytes << " bytes of cuts" << endl;
+	}
+	if(e->verbose) cout << "  total: " << (end - start) * 1000.0 << " ms, " << total_bytes << " bytes of cuts" << endl;
+
+	start = begin_phase(e, PHASE_OUTPUT);
+	for(int c = 0; c < configurations && display; c++)
+	{
+		use_store(e, stores[c]);
+		cout << endl << "Cuts for k=" << e->k << " p=" << e->p << ":" << endl;
+		print_graph_cuts(e);
+		cout << endl;
+	}
+	end_phase(e, PHASE_OUTPUT, start);
+
+	// the engine keeps the store of the last configuration
+	for(int c = 0; c < configurations - 1; c++) free_store(stores[c]);
+	use_store(e, stores[configurations - 1]);
+	free_memory(order);
+	return PK_OK;
+}
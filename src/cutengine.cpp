@@ -0,0 +1,479 @@
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <exception>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int read_graph(cut_engine* e, istream& input_file);
+int build_fanouts(cut_engine* e);
+int select_outputs(cut_engine* e, const char* list);
+int set_option(run_options& options, const char* name, const char* value);
+int initialize_cuts(cut_engine* e);
+void release_cuts(cut_engine* e);
+int evaluate_depth_first(cut_engine* e);
+int evaluate_by_levels(cut_engine* e);
+int evaluate_by_dag(cut_engine* e);
+int evaluate_by_sweep(cut_engine* e);
+int evaluate_by_partitions(cut_engine* e);
+int evaluate_while_loading(cut_engine* e, istream& input_file);
+int evaluate_configurations(cut_engine* e, bool display);
+void configure_memory(int hugepages, int numa, void* trace);
+void free_memory(void* address);
+int replace_vertex(cut_engine* e, int label, int rhs0, int rhs1);
+int add_vertex(cut_engine* e, int rhs0, int rhs1);
+int remove_vertex(cut_engine* e, int label);
+int set_output(cut_engine* e, int position, int literal);
+int recompute_cuts(cut_engine* e);
+int query_cuts(cut_engine* e, const vector<int>& vertex_indices);
+void lazy_cuts(const cut_engine* e, int vertex_index, float*& costs, int*& inputs, int& p);
+void release_lazy(cut_engine* e);
+unsigned long long hash_graph(const cut_engine* e);
+bool load_cached_cuts(cut_engine* e, unsigned long long hash);
+void store_cuts(cut_engine* e, unsigned long long hash);
+void create_signatures(cut_engine* e);
+int strash_graph(cut_engine* e);
+int reduced_label(const cut_engine* e, int label);
+int original_label(const cut_engine* e, int label);
+void release_signatures(cut_engine* e);
+bool adaptive_budget(const cut_engine* e);
+void open_counters(cut_engine* e);
+void close_counters(cut_engine* e);
+void open_trace(cut_engine* e);
+void close_trace(cut_engine* e);
+void trace_span(const cut_engine* e, const char* name, const char* category, double start, double end, const string& args);
+double wall_time();
+double begin_phase(cut_engine* e, int phase);
+void end_phase(cut_engine* e, int phase, double start);
+
+// input stream over a graph already in memory
+typedef struct mb : streambuf {
+	mb(const char* data, size_t size)
+	{
+		char* begin = const_cast<char*>(data);
+		setg(begin, begin, begin + size);
+	}
+} memory_buffer;
+
+/* ENGINE LIFE CYCLE
+******************************************************************************/
+
+// creates an engine with the default options and no graph
+cut_engine* create_engine(int k, int p)
+{
+	cut_engine* e = new cut_engine();
+	e->p = p;
+	e->k = k;
+	e->verbose = false;
+	e->options.layout = LAYOUT_SPLIT;
+	e->options.hugepages = HUGEPAGES_OFF;
+	e->options.numa = NUMA_DEFAULT;
+	e->options.engine = ENGINE_DFS;
+	e->options.threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	e->options.cone = NULL;
+	e->options.cache = NULL;
+	e->options.reuse = false;
+	e->options.strash = false;
+	e->options.budget = NULL;
+	e->options.perf_counters = false;
+	e->options.trace = NULL;
+	e->options.stream = false;
+	e->options.partitions = 1;
+	e->options.num_ks = 0;
+	e->options.num_ps = 0;
+	for(int i = 0; i < NUM_COUNTERS; i++) e->counter_fds[i] = -1;
+	e->error = PK_OK;
+	return e;
+}
+
+// releases the graph of an engine and its cuts
+void release_graph(cut_engine* e)
+{
+	release_cuts(e);
+	release_lazy(e);
+	free_memory(e->cut_origins);
+	free_memory(e->fanout_targets);
+	free_memory(e->fanout_offsets);
+	free_memory(e->vertices);
+	free_memory(e->label_map);
+	free_memory(e->original_labels);
+	free_memory(e->polarities);
+	delete[] e->outputs;
+	e->cut_origins = NULL;
+	e->fanout_targets = NULL;
+	e->fanout_offsets = NULL;
+	e->vertices = NULL;
+	e->label_map = NULL;
+	e->original_labels = NULL;
+	e->polarities = NULL;
+	e->outputs = NULL;
+	e->original_M = 0;
+	e->M = e->I = e->L = e->O = e->A = 0;
+	e->capacity = 0;
+	e->changed.clear();
+}
+
+void destroy_engine(cut_engine* e)
+{
+	release_graph(e);
+	close_counters(e);
+	close_trace(e);
+	free(e->options.cone);
+	free(e->options.cache);
+	free(e->options.budget);
+	free(e->options.trace);
+	delete e;
+}
+
+/* LOADS A GRAPH INTO AN ENGINE
+ * In streaming mode the cuts are evaluated while the graph is read; otherwise
+ * the graph can be reduced by structural hashing. The fanout lists are only
+ * built for the engines that use them, and with a cone only the selected
+ * outputs are kept.
+******************************************************************************/
+int load_graph(cut_engine* e, istream& input_file)
+{
+	release_graph(e);
+	e->error = PK_OK;
+	e->message.clear();
+	for(int i = 0; i < NUM_PHASES; i++) e->phase_seconds[i] = 0;
+	open_counters(e);
+	open_trace(e);
+	double load_start = wall_time();
+	configure_memory(e->options.hugepages, e->options.numa, e->trace);
+
+	// the streaming mode evaluates every AND vertex as it is read, in file order
+	int status;
+	if(e->options.stream && (e->options.cone != NULL || e->options.engine != ENGINE_DFS || e->options.num_ks * e->options.num_ps > 1
+		|| e->options.strash || e->options.cache != NULL))
+		status = fail(e, PK_ERROR_ARGUMENT, "The streaming mode evaluates every AND vertex as it is read: it cannot be combined with a cone, another engine, several configurations, the structural hashing or a cache.");
+	else status = e->options.stream ? evaluate_while_loading(e, input_file) : read_graph(e, input_file);
+	double start = begin_phase(e, PHASE_FANOUT);
+	if(status == PK_OK && e->options.strash) status = strash_graph(e);
+	if(status == PK_OK && (e->options.engine == ENGINE_DAG || e->options.engine == ENGINE_PARTITIONS)) status = build_fanouts(e);
+	if(status == PK_OK && e->options.cone != NULL) status = select_outputs(e, e->options.cone);
+	end_phase(e, PHASE_FANOUT, start);
+	if(status != PK_OK) release_graph(e);
+	if(e->trace != NULL) trace_span(e, "load_graph", "engine", load_start, wall_time(), "\"vertices\":" + to_string(e->M));
+	return status;
+}
+
+int load_file(cut_engine* e, const char* filename)
+{
+	ifstream input_file;
+	input_file.open(filename, ios::binary | ios::in);
+	if(!input_file.is_open())
+	{
+		release_graph(e);
+		return fail(e, PK_ERROR_OPEN, "Failed to open the input file.");
+	}
+	return load_graph(e, input_file);
+}
+
+/* EVALUATES THE PRIORITY K-CUTS OF THE GRAPH OF AN ENGINE
+ * (in streaming mode they were evaluated while the graph was read). With a
+ * cache directory, the cuts of a graph already evaluated with the same k and
+ * p are loaded instead, and the new ones are saved.
+******************************************************************************/
+int evaluate_cuts(cut_engine* e, bool display)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	configure_memory(e->options.hugepages, e->options.numa, e->trace);
+
+	bool sweep = e->options.num_ks * e->options.num_ps > 1;
+	if(!sweep && e->options.stream && e->computed) return PK_OK;
+
+	// a sweep of configurations has its own traversal (see configs.cpp)
+	if(sweep && (e->options.engine != ENGINE_DFS || e->options.cache != NULL || e->options.reuse || e->options.budget != NULL))
+		return fail(e, PK_ERROR_ARGUMENT, "Several configurations are evaluated in one pass of their own: they cannot be combined with an engine, a cache, the reuse of cuts or a budget.");
+
+	// the cuts of a previous evaluation (and the edits made since) are discarded
+	for(int i = e->I; i < e->M; i++) e->vertices[i].winner = -1;
+	e->changed.clear();
+	if(sweep)
+	{
+		int status = evaluate_configurations(e, display);
+		e->computed = status == PK_OK;
+		return status;
+	}
+
+	// the cuts of a graph seen before are taken from the cache (the cache
+	// files and the signature table have p cuts per vertex, so neither is used
+	// with an adaptive budget)
+	bool adaptive = adaptive_budget(e);
+	bool cached = e->options.cache != NULL && !adaptive;
+	if(e->verbose && e->options.budget != NULL && !adaptive) cout << "The adaptive budget only applies to the split layout, without --stream." << endl;
+	if(e->verbose && adaptive && (e->options.cache != NULL || e->options.reuse)) cout << "The cache and the reuse of cuts are not used with an adaptive budget." << endl;
+	double start = begin_phase(e, PHASE_INIT);
+	unsigned long long hash = cached ? hash_graph(e) : 0;
+	if(cached && load_cached_cuts(e, hash))
+	{
+		end_phase(e, PHASE_INIT, start);
+		e->computed = true;
+		return PK_OK;
+	}
+
+	// allocates and initializes the cuts
+	int status = initialize_cuts(e);
+	end_phase(e, PHASE_INIT, start);
+	if(status != PK_OK) return status;
+
+	// the signature table is not shared between threads or processes, so only
+	// the engines that evaluate the vertices one at a time reuse cuts
+	bool sequential = e->options.engine == ENGINE_DFS || e->options.engine == ENGINE_SWEEP;
+	start = begin_phase(e, PHASE_ENUMERATION);
+	if(e->options.reuse && sequential && !adaptive) create_signatures(e);
+	else if(e->options.reuse && !adaptive && e->verbose) cout << "The cuts are only reused by the dfs and sweep engines." << endl;
+
+	if(e->options.engine == ENGINE_LEVELS) status = evaluate_by_levels(e);
+	else if(e->options.engine == ENGINE_DAG) status = evaluate_by_dag(e);
+	else if(e->options.engine == ENGINE_SWEEP) status = evaluate_by_sweep(e);
+	else if(e->options.engine == ENGINE_PARTITIONS) status = evaluate_by_partitions(e);
+	else status = evaluate_depth_first(e);
+	release_signatures(e);
+	end_phase(e, PHASE_ENUMERATION, start);
+	e->computed = status == PK_OK;
+	start = begin_phase(e, PHASE_OUTPUT);
+	if(e->computed && cached) store_cuts(e, hash);
+	end_phase(e, PHASE_OUTPUT, start);
+	return status;
+}
+
+int compute_cuts(cut_engine* e, bool display)
+{
+	double start = wall_time();
+	int status = evaluate_cuts(e, display);
+	if(e->trace != NULL) trace_span(e, "compute_cuts", "engine", start, wall_time(), "\"k\":" + to_string(e->k) + ",\"p\":" + to_string(e->p));
+	return status;
+}
+
+/* C INTERFACE (see priokcuts.h)
+******************************************************************************/
+
+// returns the index of a vertex given by its label (in the file, when the
+// graph was reduced by structural hashing), or -1
+int vertex_of_label(const cut_engine* e, int label)
+{
+	int M = e->label_map != NULL ? e->original_M : e->M;
+	if(label < 2 || (label & 1) || (label >> 1) > M) return -1;
+	label = reduced_label(e, label);
+	return label != 0 ? (label >> 1) - 1 : -1;
+}
+
+// finds the cuts of a vertex and how many there are room for: in the cut
+// store once the cuts were computed, otherwise among the cuts evaluated on
+// demand (costs NULL if there are none)
+void find_cuts(const cut_engine* e, int vertex_index, float*& costs, int*& inputs, int& p)
+{
+	if(!e->computed)
+	{
+		lazy_cuts(e, vertex_index, costs, inputs, p);
+		return;
+	}
+	costs = NULL;
+	inputs = NULL;
+	if(e->vertices[vertex_index].winner == -1) return;
+	costs = &e->cut_costs[cost_start(e, vertex_index)];
+	inputs = &e->cut_inputs[input_start(e, vertex_index)];
+	p = cut_slots(e, vertex_index);
+}
+
+// returns the position in a list of p cuts of its index-th cut (the empty
+// positions are skipped), or -1
+int cut_position(const float* costs, int p, int index)
+{
+	if(costs == NULL) return -1;
+	for(int j = 0; j < p; j++)
+		if(costs[j] != -1 && index-- == 0) return j;
+	return -1;
+}
+
+// maps the exception being handled to an error of an engine (called in the
+// handlers of the C interface, so no exception reaches the caller)
+int exception_error(cut_engine* e, const string& action)
+{
+	try { throw; }
+	catch(bad_alloc&) { return fail(e, PK_ERROR_MEMORY, "Not enough memory to " + action + "."); }
+	catch(exception& error) { return fail(e, PK_ERROR_INTERNAL, "Failed to " + action + ": " + error.what() + "."); }
+	catch(...) { return fail(e, PK_ERROR_INTERNAL, "Failed to " + action + "."); }
+}
+
+extern "C" {
+
+pk_engine* pk_create(int k, int p)
+{
+	if(k < 2 || p < 2) return NULL;
+	try { return create_engine(k, p); }
+	catch(...) { return NULL; }
+}
+
+void pk_destroy(pk_engine* engine)
+{
+	if(engine == NULL) return;
+	try { destroy_engine(engine); }
+	catch(...) {}
+}
+
+int pk_set_option(pk_engine* engine, const char* name, const char* value)
+{
+	if(engine == NULL || name == NULL) return PK_ERROR_ARGUMENT;
+	try
+	{
+		int status = set_option(engine->options, name, value);
+		if(status == PK_ERROR_OPTION) return fail(engine, status, "Unknown option: " + string(name) + ".");
+		if(status != PK_OK) return fail(engine, status, "Missing or wrong value for the option " + string(name) + ".");
+		return PK_OK;
+	}
+	catch(...) { return exception_error(engine, "set the option"); }
+}
+
+int pk_load_file(pk_engine* engine, const char* filename)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	if(filename == NULL) return fail(engine, PK_ERROR_ARGUMENT, "No file name given.");
+	try { return load_file(engine, filename); }
+	catch(...)
+	{
+		release_graph(engine);
+		return exception_error(engine, "load the graph");
+	}
+}
+
+int pk_load_buffer(pk_engine* engine, const char* data, size_t size)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	if(data == NULL) return fail(engine, PK_ERROR_ARGUMENT, "No data given.");
+	try
+	{
+		memory_buffer buffer(data, size);
+		istream input_file(&buffer);
+		return load_graph(engine, input_file);
+	}
+	catch(...)
+	{
+		release_graph(engine);
+		return exception_error(engine, "load the graph");
+	}
+}
+
+int pk_compute(pk_engine* engine)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try { return compute_cuts(engine, false); }
+	catch(...) { return exception_error(engine, "evaluate the cuts"); }
+}
+
+int pk_replace_node(pk_engine* engine, int label, int rhs0, int rhs1)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try { return replace_vertex(engine, label, rhs0, rhs1); }
+	catch(...) { return exception_error(engine, "edit the graph"); }
+}
+
+int pk_add_node(pk_engine* engine, int rhs0, int rhs1)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try { return add_vertex(engine, rhs0, rhs1); }
+	catch(...) { return exception_error(engine, "edit the graph"); }
+}
+
+int pk_remove_node(pk_engine* engine, int label)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try { return remove_vertex(engine, label); }
+	catch(...) { return exception_error(engine, "edit the graph"); }
+}
+
+int pk_set_output(pk_engine* engine, int position, int literal)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try { return set_output(engine, position, literal); }
+	catch(...) { return exception_error(engine, "edit the graph"); }
+}
+
+int pk_recompute(pk_engine* engine)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try { return recompute_cuts(engine); }
+	catch(...) { return exception_error(engine, "evaluate the cuts"); }
+}
+
+int pk_query(pk_engine* engine, int label)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try
+	{
+		int vertex_index = vertex_of_label(engine, label);
+		if(engine->vertices != NULL && vertex_index < 0) return fail(engine, PK_ERROR_ARGUMENT, "Invalid vertex label: " + to_string(label) + ".");
+		return query_cuts(engine, vector<int>(1, vertex_index));
+	}
+	catch(...) { return exception_error(engine, "evaluate the cuts"); }
+}
+
+int pk_num_vertices(const pk_engine* engine)
+{
+	if(engine == NULL) return 0;
+	return engine->label_map != NULL ? engine->original_M : engine->M;
+}
+
+int pk_num_cuts(pk_engine* engine, int label)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try
+	{
+		if(!engine->computed && engine->lazy == NULL) return fail(engine, PK_ERROR_STATE, "The cuts were not computed.");
+		int vertex_index = vertex_of_label(engine, label);
+		if(vertex_index < 0) return fail(engine, PK_ERROR_ARGUMENT, "Invalid vertex label: " + to_string(label) + ".");
+		float* costs;
+		int* inputs;
+		int p;
+		find_cuts(engine, vertex_index, costs, inputs, p);
+		int count = 0;
+		while(cut_position(costs, p, count) >= 0) count++;
+		return count;
+	}
+	catch(...) { return exception_error(engine, "read the cuts"); }
+}
+
+int pk_get_cut(pk_engine* engine, int label, int index, int* leaves, float* cost)
+{
+	if(engine == NULL) return PK_ERROR_ARGUMENT;
+	try
+	{
+		if(!engine->computed && engine->lazy == NULL) return fail(engine, PK_ERROR_STATE, "The cuts were not computed.");
+		int vertex_index = vertex_of_label(engine, label);
+		float* costs = NULL;
+		int* inputs = NULL;
+		int p = 0;
+		if(vertex_index >= 0) find_cuts(engine, vertex_index, costs, inputs, p);
+		int position = index >= 0 ? cut_position(costs, p, index) : -1;
+		if(position < 0) return fail(engine, PK_ERROR_ARGUMENT, "Vertex " + to_string(label) + " has no cut " + to_string(index) + ".");
+
+		inputs += position * engine->k;
+		int count = 0;
+		for(int l = 0; l < engine->k; l++)
+		{
+			if(inputs[l] == -1) continue;
+			if(leaves != NULL) leaves[count] = original_label(engine, inputs[l]);
+			count++;
+		}
+		if(cost != NULL) *cost = costs[position];
+		return count;
+	}
+	catch(...) { return exception_error(engine, "read the cuts"); }
+}
+
+const char* pk_last_error(const pk_engine* engine)
+{
+	if(engine == NULL) return "No engine.";
+	return engine->message.c_str();
+}
+
+}
@@ -0,0 +1,279 @@
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include "graph.h"
+#include "threadpool.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int mark_cone(cut_engine* e, unsigned char* in_cone);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+
+// first capacity of a deque (it doubles when full)
+#define DEQUE_CAPACITY 1024
+
+// circular array of a deque (size is a power of 2)
+typedef struct da {
+	long size;
+	atomic<int>* slots;
+} deque_array;
+
+// deque of ready vertices owned by one worker, without locks (Chase and Lev):
+// the owner pushes and pops at the bottom (the vertex it just made ready is
+// still in its cache) and the other workers steal at the top; only the owner
+// writes bottom, and a single vertex left is taken by whoever moves top first.
+// When the owner fills its array it copies it into one twice as large; a
+// thief may still read the old one, so every array is kept until the end.
+typedef struct wd {
+	atomic<long> top;
+	char padding[CACHE_LINE];     // thieves write top, the owner bottom
+	atomic<long> bottom;
+	atomic<deque_array*> array;
+	vector<deque_array*> arrays;
+	char padding_end[CACHE_LINE];
+} work_deque;
+
+deque_array* new_deque_array(work_deque& d, long size)
+{
+	deque_array* a = new deque_array;
+	a->size = size;
+	a->slots = new atomic<int>[size];
+	d.arrays.push_back(a);
+	return a;
+}
+
+void initialize_deque(work_deque& d)
+{
+	d.top.store(0);
+	d.bottom.store(0);
+	d.array.store(new_deque_array(d, DEQUE_CAPACITY));
+}
+
+void release_deque(work_deque& d)
+{
+	for(size_t i = 0; i < d.arrays.size(); i++)
+	{
+		delete[] d.arrays[i]->slots;
+		delete d.arrays[i];
+	}
+	d.arrays.clear();
+}
+
+void push_back(work_deque& d, int vertex_index)
+{
+	long b = d.bottom.load(memory_order_relaxed);
+	long t = d.top.load(memory_order_acquire);
+	deque_array* a = d.array.load(memory_order_relaxed);
+	if(b - t > a->size - 1)
+	{
+		deque_array* larger = new_deque_array(d, a->size * 2);
+		for(long i = t; i < b; i++)
+			larger->slots[i & (larger->size - 1)].store(a->slots[i & (a->size - 1)].load(memory_order_relaxed), memory_order_relaxed);
+		d.array.store(larger, memory_order_release);
+		a = larger;
+	}
+	a->slots[b & (a->size - 1)].store(vertex_index, memory_order_relaxed);
+	d.bottom.store(b + 1, memory_order_release);
+}
+
+int pop_back(work_deque& d)
+{
+	long b = d.bottom.load(memory_order_relaxed) - 1;
+	deque_array* a = d.array.load(memory_order_relaxed);
+	d.bottom.store(b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long t = d.top.load(memory_order_relaxed);
+	if(t > b)
+	{
+		d.bottom.store(b + 1, memory_order_relaxed);
+		return -1;
+	}
+	int vertex_index = a->slots[b & (a->size - 1)].load(memory_order_relaxed);
+	if(t == b)
+	{
+		// the last vertex: the owner races the thieves for it
+		if(!d.top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) vertex_index = -1;
+		d.bottom.store(b + 1, memory_order_relaxed);
+	}
+	return vertex_index;
+}
+
+// returns -1 if the deque is empty or another worker took the vertex first
+int steal_front(work_deque& d)
+{
+	long t = d.top.load(memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long b = d.bottom.load(memory_order_acquire);
+	if(t >= b) return -1;
+	deque_array* a = d.array.load(memory_order_acquire);
+	int vertex_index = a->slots[t & (a->size - 1)].load(memory_order_relaxed);
+	if(!d.top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) return -1;
+	return vertex_index;
+}
+
+bool has_vertices(const work_deque& d)
+{
+	return d.bottom.load(memory_order_seq_cst) > d.top.load(memory_order_seq_cst);
+}
+
+// where the workers with nothing to do sleep: a worker counts itself as a
+// sleeper before looking at the deques, and a worker that pushes a vertex
+// looks at the sleepers after publishing it (both with sequentially
+// consistent operations), so either the sleeper sees the vertex or the pusher
+// wakes it; the pushers only read the count while nobody sleeps
+typedef struct ip {
+	mutex lock;
+	condition_variable wakeup;
+	atomic<int> sleepers;
+} idle_workers;
+
+/* DAG-SCHEDULED EVALUATION
+ *
+ * Each vertex of the cone has a counter with the number of children not
+ * evaluated yet. A worker that evaluates a vertex decrements the counters of
+ * its fanouts and pushes the ones that reach zero on its own lock-free deque;
+ * a worker with an empty deque steals from the others, and sleeps while no
+ * deque has a vertex instead of spinning. The only state shared by all the
+ * workers is touched when a worker runs out of work, not for every vertex:
+ * each worker counts the vertices it evaluates and subtracts them from the
+ * vertices remaining when its deque and its steals come up empty, and the
+ * count of sleepers is only read while it does not change. There are no
+ * barriers, so the shape of the graph (deep and narrow or shallow and wide)
+ * does not matter, and the results are identical to the depth-first
+ * traversal.
+******************************************************************************/
+int evaluate_by_dag(cut_engine* e)
+{
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	int* fanout_offsets = e->fanout_offsets;
+	int* fanout_targets = e->fanout_targets;
+	unsigned char* in_cone = (unsigned char*)allocate_memory(M, "cone marks");
+	atomic<int>* pending = (atomic<int>*)allocate_memory((size_t)M * sizeof(atomic<int>), "pending counters");
+	if(in_cone == NULL || pending == NULL)
+	{
+		free_memory(pending);
+		free_memory(in_cone);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the pending counters.");
+	}
+	int count = mark_cone(e, in_cone);
+
+	// counts the children of each vertex that must be evaluated first (the
+	// counters are constructed in the mapped memory)
+	for(int i = I; i < M; i++)
+	{
+		int children = 0;
+		if(in_cone[i])
+		{
+			int left_index = vertices[i].left;
+			int right_index = vertices[i].right;
+			if(left_index >= I && in_cone[left_index]) children++;
+			if(right_index >= I && in_cone[right_index]) children++;
+		}
+		new (&pending[i]) atomic<int>(children);
+	}
+
+	// deals the vertices ready at start to the workers
+	thread_pool pool(e->options.threads);
+	int workers = pool.size();
+	work_deque* deques = new work_deque[workers];
+	for(int w = 0; w < workers; w++) initialize_deque(deques[w]);
+	idle_workers idle;
+	idle.sleepers.store(0);
+	int next_worker = 0;
+	for(int i = I; i < M; i++)
+		if(in_cone[i] && pending[i].load(memory_order_relaxed) == 0)
+		{
+			push_back(deques[next_worker], i);
+			next_worker = (next_worker + 1) % workers;
+		}
+
+	// true if a deque has a vertex
+	auto ready = [&]() {
+		for(int w = 0; w < workers; w++) if(has_vertices(deques[w])) return true;
+		return false;
+	};
+
+	atomic<int> remaining(count);
+	atomic<long> steals(0);
+	auto work = [&](int worker, int) {
+		unsigned victim = worker;
+		long stolen = 0;
+		int evaluated = 0;     // vertices not subtracted from remaining yet
+		while(true)
+		{
+			int vertex_index = pop_back(deques[worker]);
+			for(int attempt = 1; vertex_index < 0 && attempt < workers; attempt++)
+			{
+				victim = (victim + attempt) % workers;
+				vertex_index = steal_front(deques[victim]);
+				if(vertex_index < 0) continue;
+				stolen++;
+
+				// a single worker is woken per push, so a thief that leaves
+				// vertices behind wakes the next sleeper
+				if(has_vertices(deques[victim]) && idle.sleepers.load(memory_order_relaxed) > 0)
+				{
+					lock_guard<mutex> lock(idle.lock);
+					idle.wakeup.notify_one();
+				}
+			}
+			if(vertex_index < 0)
+			{
+				if(evaluated > 0 && remaining.fetch_sub(evaluated, memory_order_acq_rel) == evaluated)
+				{
+					lock_guard<mutex> lock(idle.lock);
+					idle.wakeup.notify_all();
+				}
+				evaluated = 0;
+				if(remaining.load(memory_order_acquire) == 0) break;
+				unique_lock<mutex> lock(idle.lock);
+				idle.sleepers.fetch_add(1, memory_order_seq_cst);
+				while(!ready() && remaining.load(memory_order_acquire) > 0) idle.wakeup.wait(lock);
+				idle.sleepers.fetch_sub(1, memory_order_relaxed);
+				continue;
+			}
+
+			vertex* v = &vertices[vertex_index];
+			v->winner = compute_kcuts(e, vertex_index, v->left, v->right);
+			evaluated++;
+
+			// releases the fanouts whose children are all evaluated
+			bool pushed = false;
+			for(int j = fanout_offsets[vertex_index]; j < fanout_offsets[vertex_index + 1]; j++)
+			{
+				int fanout_index = fanout_targets[j];
+				if(in_cone[fanout_index] && pending[fanout_index].fetch_sub(1, memory_order_acq_rel) == 1)
+				{
+					push_back(deques[worker], fanout_index);
+					pushed = true;
+				}
+			}
+			if(pushed)
+			{
+				atomic_thread_fence(memory_order_seq_cst);
+				if(idle.sleepers.load(memory_order_relaxed) > 0)
+				{
+					lock_guard<mutex> lock(idle.lock);
+					idle.wakeup.notify_one();
+				}
+			}
+		}
+		steals += stolen;
+	};
+	pool.parallel_for(0, workers, 1, work);
+
+	if(e->verbose) cout << "Evaluated " << count << " vertices using " << workers << " threads (" << steals << " steals)." << endl;
+
+	for(int w = 0; w < workers; w++) release_deque(deques[w]);
+	delete[] deques;
+	free_memory(pending);
+	free_memory(in_cone);
+	return PK_OK;
+}
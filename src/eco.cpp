@@ -0,0 +1,354 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stack>
+#include <queue>
+#include <cstring>
+#include <functional>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int evaluate_fanin(cut_engine* e, int vertex_index, vertex_stack& stk);
+int allocate_cut_store(cut_engine* e);
+int build_fanouts(cut_engine* e);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+void release_lazy(cut_engine* e);
+int mark_fanin(cut_engine* e, unsigned char* in_cone, bool unevaluated_only);
+double begin_phase(cut_engine* e, int phase);
+void end_phase(cut_engine* e, int phase, double start);
+
+// index of the child given by a literal, encoded as the reader does
+// (constants are -2 and -3)
+inline int child_of(int rhs)
+{
+	return rhs >= 2 ? rhs / 2 - 1 : -rhs - 2;
+}
+
+// checks that a literal can be an input of the vertex with the given label
+inline bool valid_input(cut_engine* e, int label, int rhs)
+{
+	return rhs >= 0 && rhs < (label & ~1) && (rhs >> 1) <= e->M;
+}
+
+// gives new children to a vertex, updating the fanouts of the old and the new
+// children, which must all be evaluated again (the cuts evaluated on demand
+// are dropped)
+void set_children(cut_engine* e, int vertex_index, int rhs0, int rhs1)
+{
+	release_lazy(e);
+	vertex* v = &e->vertices[vertex_index];
+	if(v->left >= 0)
+	{
+		e->vertices[v->left].fanout--;
+		e->changed.push_back(v->left);
+	}
+	if(v->right >= 0)
+	{
+		e->vertices[v->right].fanout--;
+		e->changed.push_back(v->right);
+	}
+
+	// the AIGER order: the first input has the greater label
+	if(rhs0 < rhs1)
+	{
+		int rhs = rhs0;
+		rhs0 = rhs1;
+		rhs1 = rhs;
+	}
+	v->left = child_of(rhs0);
+	v->right = child_of(rhs1);
+	if(v->left >= 0)
+	{
+		e->vertices[v->left].fanout++;
+		e->changed.push_back(v->left);
+	}
+	if(v->right >= 0)
+	{
+		e->vertices[v->right].fanout++;
+		e->changed.push_back(v->right);
+	}
+	e->changed.push_back(vertex_index);
+}
+
+/* EDITS OF THE GRAPH
+ * The vertices keep the AIGER order (the inputs of a vertex have lower labels),
+ * so a vertex can only use vertices of lower label. The cuts are not touched
+ * until recompute_cuts.
+******************************************************************************/
+
+// gives new inputs to an AND vertex
+int replace_vertex(cut_engine* e, int label, int rhs0, int rhs1)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	if(e->label_map != NULL) return fail(e, PK_ERROR_STATE, "The graph was reduced by structural hashing and cannot be edited.");
+	if(e->cut_offsets != NULL) return fail(e, PK_ERROR_STATE, "The cuts were computed with an adaptive budget, which the edits cannot update.");
+	int vertex_index = (label >> 1) - 1;
+	if((label & 1) || vertex_index < e->I || vertex_index >= e->M)
+		return fail(e, PK_ERROR_ARGUMENT, "Vertex " + to_string(label) + " is not an AND vertex.");
+	if(!valid_input(e, label, rhs0) || !valid_input(e, label, rhs1))
+		return fail(e, PK_ERROR_ARGUMENT, "Invalid inputs " + to_string(rhs0) + " and " + to_string(rhs1) + " for the vertex " + to_string(label) + ".");
+	set_children(e, vertex_index, rhs0, rhs1);
+	return PK_OK;
+}
+
+// adds an AND vertex after the last one, returning its label
+int add_vertex(cut_engine* e, int rhs0, int rhs1)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	if(e->label_map != NULL) return fail(e, PK_ERROR_STATE, "The graph was reduced by structural hashing and cannot be edited.");
+	if(e->cut_offsets != NULL) return fail(e, PK_ERROR_STATE, "The cuts were computed with an adaptive budget, which the edits cannot update.");
+	int label = (e->M + 1) * 2;
+	if(!valid_input(e, label, rhs0) || !valid_input(e, label, rhs1))
+		return fail(e, PK_ERROR_ARGUMENT, "Invalid inputs " + to_string(rhs0) + " and " + to_string(rhs1) + " for a new vertex.");
+
+	// the vertices grow by doubling, so a series of additions is linear
+	if(e->M == e->capacity)
+	{
+		int capacity = e->capacity > 8 ? e->capacity * 2 : 16;
+		vertex* vertices = (vertex*)allocate_memory((size_t)capacity * sizeof(vertex), "vertices");
+		if(vertices == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the vertices.");
+		memcpy(vertices, e->vertices, (size_t)e->M * sizeof(vertex));
+		free_memory(e->vertices);
+		e->vertices = vertices;
+		e->capacity = capacity;
+	}
+
+	vertex* v = &e->vertices[e->M];
+	v->left = -2;
+	v->right = -2;
+	v->fanout = 0;
+	v->winner = -1;
+	e->M++;
+	e->A++;
+	set_children(e, e->M - 1, rhs0, rhs1);
+	return label;
+}
+
+// removes an AND vertex without fanout (neither AND vertices nor outputs use
+// it): it becomes the AND of two constants and its inputs lose a fanout; its
+// label may be given new inputs later
+int remove_vertex(cut_engine* e, int label)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	if(e->label_map != NULL) return fail(e, PK_ERROR_STATE, "The graph was reduced by structural hashing and cannot be edited.");
+	if(e->cut_offsets != NULL) return fail(e, PK_ERROR_STATE, "The cuts were computed with an adaptive budget, which the edits cannot update.");
+	int vertex_index = (label >> 1) - 1;
+	if((label & 1) || vertex_index < e->I || vertex_index >= e->M)
+		return fail(e, PK_ERROR_ARGUMENT, "Vertex " + to_string(label) + " is not an AND vertex.");
+	if(e->vertices[vertex_index].fanout != 0)
+		return fail(e, PK_ERROR_ARGUMENT, "Vertex " + to_string(label) + " still has fanouts.");
+	set_children(e, vertex_index, 0, 0);
+	return PK_OK;
+}
+
+// drives the output at a position (starting at 0) with another literal
+int set_output(cut_engine* e, int position, int literal)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	if(e->label_map != NULL) return fail(e, PK_ERROR_STATE, "The graph was reduced by structural hashing and cannot be edited.");
+	if(e->cut_offsets != NULL) return fail(e, PK_ERROR_STATE, "The cuts were computed with an adaptive budget, which the edits cannot update.");
+	if(position < 0 || position >= e->O) return fail(e, PK_ERROR_ARGUMENT, "Invalid output position: " + to_string(position) + ".");
+	if(literal < 0 || (literal >> 1) > e->M) return fail(e, PK_ERROR_ARGUMENT, "Invalid output literal: " + to_string(literal) + ".");
+	release_lazy(e);
+	int vertex_index = (e->outputs[position] >> 1) - 1;
+	if(vertex_index >= 0)
+	{
+		e->vertices[vertex_index].fanout--;
+		e->changed.push_back(vertex_index);
+	}
+	e->outputs[position] = literal;
+	vertex_index = (literal >> 1) - 1;
+	if(vertex_index >= 0)
+	{
+		e->vertices[vertex_index].fanout++;
+		e->changed.push_back(vertex_index);
+	}
+	return PK_OK;
+}
+
+// makes room in the cut store for the added vertices, keeping the cuts
+int grow_cut_store(cut_engine* e)
+{
+	float* cut_costs = e->cut_costs;
+	int* cut_inputs = e->cut_inputs;
+	int rows = e->cut_rows;
+	int status = allocate_cut_store(e);
+	if(status != PK_OK)
+	{
+		free_memory(e->cut_costs);
+		free_memory(e->cut_inputs);
+		e->cut_costs = cut_costs;
+		e->cut_inputs = cut_inputs;
+		e->cut_rows = rows;
+		return status;
+	}
+	if(e->options.layout == LAYOUT_AOS) memcpy(e->cut_costs, cut_costs, (size_t)rows * e->cost_offset * sizeof(int));
+	else
+	{
+		memcpy(e->cut_costs, cut_costs, (size_t)rows * e->cost_offset * sizeof(float));
+		memcpy(e->cut_inputs, cut_inputs, (size_t)rows * e->input_offset * sizeof(int));
+	}
+	free_memory(cut_costs);
+	free_memory(cut_inputs);
+	return PK_OK;
+}
+
+// removes the cuts of a vertex no longer evaluated
+void clear_cuts(cut_engine* e, int vertex_index)
+{
+	float* costs = &e->cut_costs[cost_start(e, vertex_index)];
+	int* inputs = &e->cut_inputs[input_start(e, vertex_index)];
+	for(int j = 0; j < cut_slots(e, vertex_index); j++) costs[j] = -1;
+	for(int l = 0; l < cut_slots(e, vertex_index) * e->k; l++) inputs[l] = -1;
+	e->vertices[vertex_index].winner = -1;
+}
+
+/* INCREMENTAL RECOMPUTATION AFTER EDITS
+ *
+ * Only the transitive fanout of the edited vertices can change: the edited
+ * vertices themselves, and the vertices whose fanout changed (their costs are
+ * divided by the fanout). They are evaluated again in index order, so the
+ * children of a vertex are always up to date before the vertex. When the cuts
+ * of a vertex come out identical, its fanouts are not visited on its account,
+ * which stops the propagation early.
+ * Vertices not evaluated before are skipped during the propagation. At the
+ * end, the vertices a full run would evaluate but that have no cuts (used by
+ * an edited vertex or a new output) are evaluated with their fanin, and the
+ * evaluated vertices a full run would not evaluate (left without fanout, or
+ * only feeding such vertices) lose their cuts, so the cuts are the same as a
+ * full run of the edited graph.
+ * Returns the number of vertices evaluated.
+******************************************************************************/
+int recompute_cuts(cut_engine* e)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	if(!e->computed) return fail(e, PK_ERROR_STATE, "The cuts were not computed.");
+	if(e->changed.empty()) return 0;
+
+	double start = begin_phase(e, PHASE_ENUMERATION);
+	int status = e->cut_rows < e->M ? grow_cut_store(e) : PK_OK;
+	if(status != PK_OK) return status;
+
+	// the fanout lists are rebuilt for the edited graph
+	free_memory(e->fanout_targets);
+	free_memory(e->fanout_offsets);
+	e->fanout_targets = NULL;
+	e->fanout_offsets = NULL;
+	status = build_fanouts(e);
+	if(status != PK_OK) return status;
+
+	vertex* vertices = e->vertices;
+	vector<bool> queued(e->M, false);
+	priority_queue<int, vector<int>, greater<int>> pending;
+	for(int j = 0; j < e->changed.size(); j++)
+		if(!queued[e->changed[j]])
+		{
+			queued[e->changed[j]] = true;
+			pending.push(e->changed[j]);
+		}
+	e->changed.clear();
+
+	vertex_stack stk;
+	vector<float> old_costs(e->p);
+	vector<int> old_inputs((size_t)e->p * e->k);
+	int evaluated = 0;
+	int unchanged = 0;
+	while(!pending.empty())
+	{
+		int vertex_index = pending.top();
+		pending.pop();
+		vertex* v = &vertices[vertex_index];
+		if(vertex_index < e->I || v->winner == -1) continue;
+		if(v->fanout == 0)
+		{
+			clear_cuts(e, vertex_index);
+			continue;
+		}
+
+		// the cuts of the AoS layout are contiguous too: the costs, then the inputs
+		float* costs = &e->cut_costs[(size_t)vertex_index * e->cost_offset];
+		int* inputs = &e->cut_inputs[(size_t)vertex_index * e->input_offset];
+		memcpy(&old_costs[0], costs, e->p * sizeof(float));
+		memcpy(&old_inputs[0], inputs, (size_t)e->p * e->k * sizeof(int));
+		int old_winner = v->winner;
+
+		evaluated += evaluate_fanin(e, vertex_index, stk);
+		if(v->winner == old_winner && memcmp(&old_costs[0], costs, e->p * sizeof(float)) == 0
+			&& memcmp(&old_inputs[0], inputs, (size_t)e->p * e->k * sizeof(int)) == 0)
+		{
+			unchanged++;
+			continue;
+		}
+		for(int j = e->fanout_offsets[vertex_index]; j < e->fanout_offsets[vertex_index + 1]; j++)
+		{
+			int fanout_index = e->fanout_targets[j];
+			if(!queued[fanout_index])
+			{
+				queued[fanout_index] = true;
+				pending.push(fanout_index);
+			}
+		}
+	}
+
+	// the vertices a full run of the edited graph evaluates (the cone of the
+	// outputs, with every engine): the ones not evaluated yet are evaluated
+	// with their fanin, and the others lose their cuts, such as the fanin of a
+	// cone that lost its last fanout
+	unsigned char* live = (unsigned char*)allocate_memory(e->M, "cone marks");
+	if(live == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the cone marks.");
+	mark_fanin(e, live, false);
+	for(int i = e->I; i < e->M; i++)
+	{
+		if(live[i] && vertices[i].winner == -1) evaluated += evaluate_fanin(e, i, stk);
+		else if(!live[i] && vertices[i].winner != -1) clear_cuts(e, i);
+	}
+	free_memory(live);
+
+	end_phase(e, PHASE_ENUMERATION, start);
+
+	if(e->verbose)
+		cout << "Recomputed the cuts of " << evaluated << " vertices after the edits (" << unchanged
+			 << " with unchanged cuts stopped the propagation)." << endl;
+	return evaluated;
+}
+
+/* APPLIES THE EDITS LISTED IN A FILE
+ * One edit per line, with the labels of the AIGER format:
+ *   replace <label> <rhs0> <rhs1>
+ *   add <rhs0> <rhs1>          (the new vertex gets the next label)
+ *   remove <label>
+ *   output <position> <literal>
+ * Empty lines and lines starting with # are ignored. Returns the number of
+ * edits.
+******************************************************************************/
+int apply_edits(cut_engine* e, const char* filename)
+{
+	ifstream edits(filename);
+	if(!edits.is_open()) return fail(e, PK_ERROR_OPEN, "Failed to open the edit file.");
+
+	string line;
+	int line_number = 0;
+	int count = 0;
+	while(getline(edits, line))
+	{
+		line_number++;
+		istringstream words(line);
+		string command;
+		if(!(words >> command) || command[0] == '#') continue;
+
+		int label, rhs0, rhs1;
+		int status = PK_ERROR_FORMAT;
+		if(command == "replace" && words >> label >> rhs0 >> rhs1) status = replace_vertex(e, label, rhs0, rhs1);
+		else if(command == "add" && words >> rhs0 >> rhs1) status = add_vertex(e, rhs0, rhs1);
+		else if(command == "remove" && words >> label) status = remove_vertex(e, label);
+		else if(command == "output" && words >> label >> rhs0) status = set_output(e, label, rhs0);
+		else fail(e, status, "Unknown or incomplete edit.");
+		if(status < 0) return fail(e, status, "Line " + to_string(line_number) + " of the edit file: " + e->message);
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,343 @@
+#include <iostream>
+#include <vector>
+#include <stack>
+#include <atomic>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+bool in_the_list(int vertex_index, product_list* list);
+int winner_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset);
+int loser_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset);
+int allocate_cut_store(cut_engine* e);
+void report_memory_policy();
+void free_memory(void* address);
+int reuse_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+void trace_kernel_call(const cut_engine* e);
+
+/* COMPUTES THE K-CUTS FOR A VERTEX
+ * Return value: the index of the winner cut (-1 if the vertex has no fanout)
+*****************************************************************************/
+int enumerate_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index)
+{
+
+    int p = e->p;
+    int k = e->k;
+    vertex* vertices = e->vertices;
+    float* cut_costs = e->cut_costs;
+    int* cut_inputs = e->cut_inputs;
+    int cost_offset = e->cost_offset;
+    int* cut_origins = e->cut_origins;
+
+    int winner_index = 0;
+    int fanout = e->defer_normalization ? 1 : vertices[vertex_index].fanout;
+    int label = e->labels != NULL ? e->labels[vertex_index] : (vertex_index + 1) * 2;
+
+    // a vertex without fanout is never evaluated (see the engines)
+    if (fanout == 0)
+        return -1;
+    KERNEL_STATS;
+    KERNEL_STAT(vertices);
+
+    // where the cut lists of the vertex and of its children start, and how
+    // many cuts each one has room for (p, unless the store has an adaptive
+    // budget; a constant child has p copies of its empty cut)
+    size_t vertex_cost = cost_start(e, vertex_index);
+    size_t vertex_input = input_start(e, vertex_index);
+    int vertex_slots = cut_slots(e, vertex_index);
+    size_t left_cost = left_index >= 0 ? cost_start(e, left_index) : 0;
+    size_t left_input = left_index >= 0 ? input_start(e, left_index) : 0;
+    int left_slots = left_index >= 0 ? cut_slots(e, left_index) : p;
+    size_t right_cost = right_index >= 0 ? cost_start(e, right_index) : 0;
+    size_t right_input = right_index >= 0 ? input_start(e, right_index) : 0;
+    int right_slots = right_index >= 0 ? cut_slots(e, right_index) : p;
+
+    // initialize the cuts of the vertex
+    for (int j = 0; j < vertex_slots; j++)
+    {
+        cut_costs[vertex_cost + j] = -1.0;
+        for (int l = 0; l < k; l++)
+            cut_inputs[vertex_input + j * k + l] = -1;
+    }
+
+    // computes the cartesian product
+    product_list product;
+    float product_cost;
+    float left_cut_cost;
+    float right_cut_cost;
+
+    for (int j = 0; j < left_slots; j++)
+    {
+        for (int z = 0; z < right_slots; z++)
+        {
+
+            product.clear();
+
+            // EVALUATES THE COST OF THE PRODUCT
+            // the cost of a given product is equal the sum osum of the costsum of the costs
+            // of each cut divided by the fanout
+            if (left_index >= 0)
+                left_cut_cost = cut_costs[left_cost + j];
+            else
+                left_cut_cost = 0.0;
+            if (right_index >= 0)
+                right_cut_cost = cut_costs[right_cost + z];
+            else
+                right_cut_cost = 0.0;
+            product_cost = (left_cut_cost + right_cut_cost) / (float)fanout;
+
+            // COMPUTES THE PRODUCT
+            // a negative number for the cost is a flag for an empty space left
+            // in the cost vector. So if one of the cuts has a negative value,
+            // jump for the next
+            if (left_cut_cost < 0 || right_cut_cost < 0)
+            {
+                KERNEL_STAT(empty_pairs);
+                continue;
+            }
+            else
+            {
+                KERNEL_STAT(pairs);
+                if (left_index >= 0)
+                {
+                    for (int l = 0; l < k; l++)
+                        if (cut_inputs[left_input + j * k + l] != -1)
+                            product.push_back(cut_inputs[left_input + j * k + l]);
+                }
+                else product.push_back(-(left_index + 2));
+                if (right_index >= 0)
+                {
+                    for (int l = 0; l < k; l++)
+                        if (!in_the_list(cut_inputs[right_input + z * k + l], &product) && cut_inputs[right_input + z * k + l] != -1)
+                            product.push_back(cut_inputs[right_input + z * k + l]);
+                }
+                else product.push_back(-(right_index + 2));
+
+                // If the product has a lower cost than some cut placed
+                // in the vertex cuts list before, replaces the cut
+                // If there is an empty space in the vertex's cuts list,
+                // place the product in the list
+                // If the product has more than k inputs, it is discarded
+                KERNEL_HISTOGRAM(leaves, (int)product.size());
+                if (product.size() <= k)
+                {
+                    int l;
+                    for (l = 0; l < vertex_slots; l++)
+                    {
+                        int actual_cost = cut_costs[vertex_cost + l];
+                        if (actual_cost == -1 || actual_cost > product_cost)
+                        {
+                            if (actual_cost == -1) KERNEL_STAT(fills);
+                            else KERNEL_STAT(replacements);
+                            cut_costs[vertex_cost + l] = product_cost;
+                            for (int m = 0; m < k; m++)
+                                cut_inputs[vertex_input + l * k + m] = -1;
+                            for (int m = 0; m < product.size(); m++)
+                                cut_inputs[vertex_input + l * k + m] = product.at(m);
+                            if (cut_origins != NULL)
+                                cut_origins[vertex_index * p + l] = j * p + z;
+                            break;
+                        }
+                    }
+                    if (l == vertex_slots)
+                        KERNEL_STAT(discarded);
+                }
+                else
+                    KERNEL_STAT(rejected);
+            }
+        }
+    }
+
+    // evaluates the cost of the autocut (the winner is searched in the list
+    // of the vertex alone, then given as a position in the whole store)
+    winner_index = vertex_cost + winner_cut(0, &cut_costs[vertex_cost], vertex_slots, cost_offset);
+    float winner_cost = cut_costs[winner_index];
+    float autocut_cost = winner_cost + (1.0 / (float)fanout);
+
+    // the origin of an autocut is -(origin of the winner product + 2), or -1
+    // if there was no product
+    int autocut_origin = -1;
+    if (cut_origins != NULL && winner_cost >= 0)
+        autocut_origin = -(cut_origins[vertex_index * p + winner_index - vertex_cost] + 2);
+
+    // inserts the autocut in a free position (if there is), OR
+    // replaces a cut "worse" than the autocut (a cut with higher cost)
+    bool replaced_or_inserted = false;
+    for (int l = 0; l < vertex_slots; l++)
+        if (!replaced_or_inserted)
+        {
+            int actual_cost = cut_costs[vertex_cost + l];
+            if (actual_cost == -1 || actual_cost > autocut_cost)
+            {
+                if (actual_cost == -1) KERNEL_STAT(autocut_fills);
+                else KERNEL_STAT(autocut_replacements);
+                cut_costs[vertex_cost + l] = autocut_cost;
+                for (int m = 0; m < k; m++)
+                    cut_inputs[vertex_input + l * k + m] = -1;
+                cut_inputs[vertex_input + l * k] = label;
+                if (cut_origins != NULL)
+                    cut_origins[vertex_index * p + l] = autocut_origin;
+                replaced_or_inserted = true;
+            }
+        }
+
+    // if there's no free position and no cut is worse than the autocut,
+    // chooses the cut with the highest cost ("loser" cut) and replaces it
+    if (!replaced_or_inserted)
+    {
+        KERNEL_STAT(loser_evictions);
+        int loser_cut_index = loser_cut(0, &cut_costs[vertex_cost], vertex_slots, cost_offset);
+        cut_costs[vertex_cost + loser_cut_index] = autocut_cost;
+        for (int m = 0; m < k; m++)
+            cut_inputs[vertex_input + loser_cut_index * k + m] = -1;
+        cut_inputs[vertex_input + loser_cut_index * k] = label;
+        if (cut_origins != NULL)
+            cut_origins[vertex_index * p + loser_cut_index] = autocut_origin;
+    }
+
+#ifdef PK_STATS
+    int kept = 0;
+    for (int l = 0; l < vertex_slots; l++)
+        if (cut_costs[vertex_cost + l] != -1)
+            kept++;
+    KERNEL_HISTOGRAM(occupancy, kept);
+#endif
+
+    return winner_index;
+}
+
+// computes the k-cuts of a vertex, reusing the cuts of a vertex with the same
+// fanin structure when the engine keeps a signature table (see signatures.cpp)
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index)
+{
+    if (e->trace != NULL)
+        trace_kernel_call(e);
+    if (e->signatures != NULL && e->cut_origins == NULL)
+        return reuse_kcuts(e, vertex_index, left_index, right_index);
+    return enumerate_kcuts(e, vertex_index, left_index, right_index);
+}
+
+// releases the cuts of an engine (in the AoS layout cut_inputs points inside
+// the records, which the allocation layer does not know and ignores)
+void release_cuts(cut_engine* e)
+{
+    free_memory(e->cut_costs);
+    free_memory(e->cut_inputs);
+    free_memory(e->cut_offsets);
+    e->cut_costs = NULL;
+    e->cut_inputs = NULL;
+    e->cut_offsets = NULL;
+    e->cut_rows = 0;
+    e->computed = false;
+}
+
+/* ALLOCATES THE CUTS AND SETS THE CUTS OF THE INPUTS
+ * (the cuts of a previous evaluation are released)
+*****************************************************************************/
+int initialize_cuts(cut_engine* e)
+{
+
+    release_cuts(e);
+
+    // allocates memory for the cuts
+    // the split layout keeps the costs and the inputs in two separate arrays;
+    // the interleaved (AoS) layout keeps the p costs and the p*k inputs of a
+    // vertex together in one record padded to a multiple of the cache line
+    int status = allocate_cut_store(e);
+    if(status != PK_OK) return status;
+    if(e->verbose && (e->options.hugepages != HUGEPAGES_OFF || e->options.numa != NUMA_DEFAULT)) report_memory_policy();
+
+    int k = e->k;
+    float* cut_costs = e->cut_costs;
+    int* cut_inputs = e->cut_inputs;
+
+    // set to zero the cost of each input vertex cut
+    // fill blank spaces left in the vector with -1
+    // set the winner cut of each input
+    for(int i = 0; i < e->I; i++)
+    {
+        size_t first_cost = cost_start(e, i);
+        size_t first_input = input_start(e, i);
+        e->vertices[i].winner = i;
+        cut_costs[first_cost] = 0;
+        cut_inputs[first_input] = (i+1) << 1;
+        for(int l = 1; l < k; l++) cut_inputs[first_input+l] = -1;
+        for(int j = 1; j < cut_slots(e, i); j++)
+        {
+            cut_costs[first_cost + j] = -1;
+            for(int l = 0; l < k; l++) cut_inputs[first_input+j*k+l] = -1;
+        }
+    }
+
+    return PK_OK;
+
+}
+
+/* EVALUATES A VERTEX AFTER THE VERTICES OF ITS TRANSITIVE FANIN NOT EVALUATED YET
+ * Return value: the number of vertices evaluated
+*****************************************************************************/
+int evaluate_fanin(cut_engine* e, int vertex_index, vertex_stack& stk)
+{
+
+    vertex* vertices = e->vertices;
+    int count = 0;
+
+    vertex* v = &vertices[vertex_index];
+    while(v != NULL)
+    {
+        int left_index = v->left;
+        int right_index = v->right;
+        vertex* left = left_index >= 0 ? &vertices[left_index] : NULL;
+        vertex* right = right_index >= 0 ? &vertices[right_index] : NULL;
+        if(left != NULL && left->winner == -1)
+        {
+            stk.push(vertex_index);
+            v = left;
+            vertex_index = left_index;
+        }
+        else if(right != NULL && right->winner == -1)
+        {
+            stk.push(vertex_index);
+            v = right;
+            vertex_index = right_index;
+        }
+        else
+        {   
+            v->winner = compute_kcuts(e, vertex_index, left_index, right_index);
+            count++;
+            if(stk.empty()) v = NULL;
+            else
+            {
+                vertex_index = stk.top();
+                stk.pop();
+                v = &vertices[vertex_index];
+            }
+        }
+    }
+
+    return count;
+
+}
+
+/* EVALUATES THE PRIORITY K-CUTS WITH A DEPTH-FIRST TRAVERSAL FROM EACH OUTPUT
+*****************************************************************************/
+int evaluate_depth_first(cut_engine* e)
+{
+
+    // the auxiliary stack
+    vertex_stack stk;
+
+    for(int i = 0; i < e->O; i++)
+    {
+        int vertex_index = (e->outputs[i] >> 1) - 1;
+
+        // constant outputs, outputs driven by inputs and outputs already
+        // evaluated by a previous cone have nothing left to compute
+        if(vertex_index < 0 || e->vertices[vertex_index].winner != -1) continue;
+
+        evaluate_fanin(e, vertex_index, stk);
+    }
+
+    return PK_OK;
+
+}
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stack>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+void print_vertex_cuts(cut_engine* e, int label, float* costs, int* inputs, int p);
+int reduced_label(const cut_engine* e, int label);
+double begin_phase(cut_engine* e, int phase);
+void end_phase(cut_engine* e, int phase, double start);
+
+// cuts evaluated on demand: each vertex touched by a query gets a slot, and
+// the slots are stored contiguously, so the memory grows with the cones of the
+// queries and not with the size of the graph
+typedef struct lm {
+	int p;
+	int k;
+	unordered_map<int, int> slots;   // vertex index -> slot
+	vector<vertex> vertices;         // per slot: children as slots, fanout and winner of the vertex
+	vector<int> labels;              // per slot: label of the vertex
+	vector<float> cut_costs;         // p costs per slot
+	vector<int> cut_inputs;          // p*k inputs per slot
+} lazy_memo;
+
+// releases the cuts evaluated on demand (the graph changed)
+void release_lazy(cut_engine* e)
+{
+	delete (lazy_memo*)e->lazy;
+	e->lazy = NULL;
+}
+
+// returns the cuts of a vertex evaluated on demand and how many there are room
+// for (costs NULL if the vertex was not evaluated or has no cuts)
+void lazy_cuts(const cut_engine* e, int vertex_index, float*& costs, int*& inputs, int& p)
+{
+	costs = NULL;
+	inputs = NULL;
+	lazy_memo* memo = (lazy_memo*)e->lazy;
+	if(memo == NULL) return;
+	p = memo->p;
+	unordered_map<int, int>::iterator found = memo->slots.find(vertex_index);
+	if(found == memo->slots.end() || memo->vertices[found->second].winner == -1) return;
+	costs = &memo->cut_costs[(size_t)found->second * memo->p];
+	inputs = &memo->cut_inputs[(size_t)found->second * memo->p * memo->k];
+}
+
+/* ON-DEMAND EVALUATION OF THE CUTS OF SOME VERTICES
+ *
+ * Only the transitive fanin of the requested vertices is evaluated, and only
+ * the part of it not evaluated by an earlier query. The new vertices are
+ * found with a depth-first search that stops at the vertices already in the
+ * memo, sorted by index (children before parents) and given the next slots.
+ * compute_kcuts then works on a view of the engine whose vertices and cuts
+ * are the slots, with the fanouts and the labels of the whole graph, so the
+ * cuts are the same as the ones of a full evaluation.
+ * Returns the number of vertices evaluated.
+******************************************************************************/
+int query_cuts(cut_engine* e, const vector<int>& vertex_indices)
+{
+	if(e->vertices == NULL) return fail(e, PK_ERROR_STATE, "No graph loaded.");
+	lazy_memo* memo = (lazy_memo*)e->lazy;
+	if(memo != NULL && (memo->p != e->p || memo->k != e->k)) release_lazy(e);
+	if(e->lazy == NULL)
+	{
+		memo = new lazy_memo();
+		memo->p = e->p;
+		memo->k = e->k;
+		e->lazy = memo;
+	}
+	int p = memo->p;
+	int k = memo->k;
+
+	// finds the vertices of the fanin not evaluated yet
+	double start = begin_phase(e, PHASE_ENUMERATION);
+	vector<int> found;
+	unordered_set<int> seen;
+	vertex_stack stk;
+	for(int i = 0; i < vertex_indices.size(); i++)
+	{
+		int vertex_index = vertex_indices[i];
+		if(vertex_index < 0 || vertex_index >= e->M)
+			return fail(e, PK_ERROR_ARGUMENT, "Invalid vertex label: " + to_string((vertex_index + 1) * 2) + ".");
+		if(memo->slots.count(vertex_index) == 0 && seen.insert(vertex_index).second) stk.push(vertex_index);
+	}
+	while(!stk.empty())
+	{
+		int vertex_index = stk.top();
+		stk.pop();
+		found.push_back(vertex_index);
+		if(vertex_index < e->I) continue;
+		int children[2] = {e->vertices[vertex_index].left, e->vertices[vertex_index].right};
+		for(int c = 0; c < 2; c++)
+			if(children[c] >= 0 && memo->slots.count(children[c]) == 0 && seen.insert(children[c]).second)
+				stk.push(children[c]);
+	}
+	sort(found.begin(), found.end());
+
+	// gives them slots, with the children given as slots too
+	int first = memo->vertices.size();
+	for(int i = 0; i < found.size(); i++)
+	{
+		vertex* v = &e->vertices[found[i]];
+		vertex slot;
+		slot.left = v->left >= 0 ? memo->slots[v->left] : v->left;
+		slot.right = v->right >= 0 ? memo->slots[v->right] : v->right;
+		slot.fanout = v->fanout;
+		slot.winner = -1;
+		memo->slots[found[i]] = first + i;
+		memo->vertices.push_back(slot);
+		memo->labels.push_back((found[i] + 1) << 1);
+	}
+	memo->cut_costs.resize(memo->vertices.size() * p);
+	memo->cut_inputs.resize(memo->vertices.size() * p * k);
+
+	// evaluates the new slots in index order
+	cut_engine view = cut_engine();
+	view.p = p;
+	view.k = k;
+	view.vertices = memo->vertices.data();
+	view.labels = memo->labels.data();
+	view.cut_costs = memo->cut_costs.data();
+	view.cut_inputs = memo->cut_inputs.data();
+	view.cost_offset = p;
+	view.input_offset = p * k;
+	for(int i = 0; i < found.size(); i++)
+	{
+		int slot = first + i;
+		vertex* v = &memo->vertices[slot];
+		if(found[i] >= e->I)
+		{
+			v->winner = compute_kcuts(&view, slot, v->left, v->right);
+			continue;
+		}
+		// an input is its own cut, with cost zero
+		v->winner = slot;
+		for(int j = 0; j < p; j++) view.cut_costs[slot * p + j] = j == 0 ? 0 : -1;
+		for(int l = 0; l < p * k; l++) view.cut_inputs[slot * p * k + l] = -1;
+		view.cut_inputs[slot * p * k] = memo->labels[slot];
+	}
+	end_phase(e, PHASE_ENUMERATION, start);
+
+	if(e->verbose)
+		cout << "Evaluated " << found.size() << " vertices for " << vertex_indices.size() << " requested vertices ("
+			 << memo->vertices.size() << " vertices memoized, "
+			 << memo->vertices.size() * (sizeof(vertex) + p * sizeof(float) + p * k * sizeof(int)) << " bytes of cuts)." << endl;
+	return found.size();
+}
+
+// reads the labels of the requested vertices: a comma separated list, or the
+// name of a file with labels separated by spaces, commas or new lines (the
+// labels are the ones of the file, also after structural hashing); each
+// vertex is added with its index in the graph and its label in the file
+int parse_queries(cut_engine* e, const char* list, vector<int>& vertex_indices, vector<int>& vertex_labels)
+{
+	string labels = list;
+	if(labels.find_first_not_of("0123456789,") != string::npos)
+	{
+		ifstream query_file(list);
+		if(!query_file.is_open()) return fail(e, PK_ERROR_OPEN, "Failed to open the file of requested vertices.");
+		labels.assign(istreambuf_iterator<char>(query_file), istreambuf_iterator<char>());
+	}
+	for(int i = 0; i < labels.size(); i++) if(labels[i] == ',' || labels[i] == '\n' || labels[i] == '\t' || labels[i] == '\r') labels[i] = ' ';
+
+	char* save;
+	char* token = strtok_r(&labels[0], " ", &save);
+	while(token != NULL)
+	{
+		char* end;
+		long label = strtol(token, &end, 10);
+		int M = e->label_map != NULL ? e->original_M : e->M;
+		if(*end != '\0' || label < 2 || (label >> 1) > M)
+			return fail(e, PK_ERROR_ARGUMENT, "Invalid vertex label in --nodes: " + string(token) + ".");
+		if(reduced_label(e, label) == 0)
+			return fail(e, PK_ERROR_ARGUMENT, "Vertex " + string(token) + " was removed by the structural hashing.");
+		vertex_indices.push_back((reduced_label(e, label) >> 1) - 1);
+		vertex_labels.push_back(label & ~1);
+		token = strtok_r(NULL, " ", &save);
+	}
+	return PK_OK;
+}
+
+// returns the number of AND vertices evaluated on demand
+int lazy_evaluated(const cut_engine* e)
+{
+	lazy_memo* memo = (lazy_memo*)e->lazy;
+	int count = 0;
+	if(memo != NULL)
+		for(int i = 0; i < memo->labels.size(); i++) if((memo->labels[i] >> 1) > e->I && memo->vertices[i].winner != -1) count++;
+	return count;
+}
+
+// prints the cuts of the requested vertices under the labels requested (a
+// vertex merged by the structural hashing shows the cuts of the vertex it was
+// merged into under its own label)
+void print_queries(cut_engine* e, const vector<int>& vertex_indices, const vector<int>& labels)
+{
+	for(int i = 0; i < vertex_indices.size(); i++)
+	{
+		float* costs;
+		int* inputs;
+		int p;
+		lazy_cuts(e, vertex_indices[i], costs, inputs, p);
+		if(costs != NULL) print_vertex_cuts(e, labels[i], costs, inputs, p);
+	}
+}
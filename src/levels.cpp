@@ -0,0 +1,100 @@
+#include <iostream>
+#include <cstring>
+#include "graph.h"
+#include "threadpool.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int mark_cone(cut_engine* e, unsigned char* in_cone);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+
+/* LEVEL-SYNCHRONOUS EVALUATION
+ *
+ * The level of an input is 0 and the level of an AND vertex is one more than
+ * the highest level of its children, so the vertices of a level only depend
+ * on vertices of lower levels and can be evaluated in any order. AIGER lists
+ * the children of a vertex before the vertex, so a single pass by index
+ * computes all the levels. The vertices are bucketed by level and each level
+ * is evaluated by the thread pool, with a barrier between levels.
+ * Only the vertices in the cone of the outputs are evaluated, exactly as in
+ * the depth-first traversal.
+******************************************************************************/
+int evaluate_by_levels(cut_engine* e)
+{
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	unsigned char* in_cone = (unsigned char*)allocate_memory(M, "cone marks");
+	int* level = (int*)allocate_memory((size_t)M * sizeof(int), "levels");
+	if(in_cone == NULL || level == NULL)
+	{
+		free_memory(level);
+		free_memory(in_cone);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the levels.");
+	}
+	int count = mark_cone(e, in_cone);
+
+	// evaluates the level of each vertex of the cone
+	int num_levels = 0;
+	for(int i = I; i < M; i++)
+	{
+		if(!in_cone[i]) continue;
+		int left_index = vertices[i].left;
+		int right_index = vertices[i].right;
+		int left_level = left_index >= I && in_cone[left_index] ? level[left_index] : 0;
+		int right_level = right_index >= I && in_cone[right_index] ? level[right_index] : 0;
+		level[i] = (left_level > right_level ? left_level : right_level) + 1;
+		if(level[i] > num_levels) num_levels = level[i];
+	}
+
+	// buckets the vertices by level (counting sort)
+	int* level_start = (int*)allocate_memory((size_t)(num_levels + 2) * sizeof(int), "level offsets");
+	int* level_order = (int*)allocate_memory((size_t)count * sizeof(int), "level order");
+	if(level_start == NULL || level_order == NULL)
+	{
+		free_memory(level_order);
+		free_memory(level_start);
+		free_memory(level);
+		free_memory(in_cone);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the levels.");
+	}
+	for(int i = I; i < M; i++) if(in_cone[i]) level_start[level[i] + 1]++;
+	int widest = 0;
+	for(int l = 1; l <= num_levels + 1; l++)
+	{
+		if(level_start[l] > widest) widest = level_start[l];
+		level_start[l] += level_start[l - 1];
+	}
+	for(int i = I; i < M; i++) if(in_cone[i]) level_order[level_start[level[i]]++] = i;
+	for(int l = num_levels; l > 0; l--) level_start[l] = level_start[l - 1];
+	level_start[0] = 0;
+
+	// evaluates the levels from the bottom up
+	thread_pool pool(e->options.threads);
+	auto evaluate = [&](int first, int last) {
+		for(int j = first; j < last; j++)
+		{
+			int vertex_index = level_order[j];
+			vertex* v = &vertices[vertex_index];
+			v->winner = compute_kcuts(e, vertex_index, v->left, v->right);
+		}
+	};
+	for(int l = 1; l <= num_levels; l++)
+	{
+		int size = level_start[l + 1] - level_start[l];
+		int grain = size / (pool.size() * 8);
+		pool.parallel_for(level_start[l], level_start[l + 1], grain > 16 ? grain : 16, evaluate);
+	}
+
+	if(e->verbose)
+		cout << "Evaluated " << count << " vertices in " << num_levels << " levels (widest level: "
+			 << widest << " vertices) using " << pool.size() << " threads." << endl;
+
+	free_memory(level_order);
+	free_memory(level_start);
+	free_memory(level);
+	free_memory(in_cone);
+	return PK_OK;
+}
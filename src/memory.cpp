@@ -0,0 +1,456 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+void trace_allocation(const char* name, size_t bytes, bool allocated, long long mapped);
+void trace_memory(void* trace);
+
+// flags and policies missing from older system headers
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#define MPOL_DEFAULT    0
+#define MPOL_INTERLEAVE 3
+
+// page sizes actually obtained by an allocation
+#define PAGES_4K  0
+#define PAGES_THP 1
+#define PAGES_2M  2
+#define PAGES_1G  3
+
+typedef struct a {
+	const char* name;
+	int subsystem;
+	void* address;
+	size_t bytes;
+	size_t mapped;
+	int pages;
+	int numa;
+	int numa_error;
+	bool shared;
+	bool file;
+} allocation;
+
+// policies requested by the user (per thread, so engines evaluated on
+// different threads keep their own policies)
+thread_local int memory_hugepages = HUGEPAGES_OFF;
+thread_local int memory_numa = NUMA_DEFAULT;
+
+// when set, the allocations are POSIX shared memory segments named after
+// this prefix, inherited by the processes forked afterwards
+thread_local const char* memory_segment = NULL;
+int memory_segments = 0;
+
+// allocations done through this layer
+vector<allocation> allocations;
+mutex allocations_lock;
+
+// memory of a subsystem: bytes in use and their peak, bytes and number of
+// allocations since the process started
+typedef struct ma {
+	long long live;
+	long long peak;
+	long long bytes;
+	long long count;
+} memory_account;
+
+// accounts of the process (guarded by allocations_lock)
+memory_account memory_accounts[NUM_SUBSYSTEMS];
+
+// memory mapped by this layer (guarded by allocations_lock), for the trace
+long long mapped_bytes = 0;
+
+// mappings released by a thread and kept for its next allocations (see
+// retain_memory), oldest first
+#define RETAINED_MAPPINGS 32
+typedef struct rm {
+	void* address;
+	size_t mapped;
+} retained_mapping;
+typedef struct rl {
+	bool enabled;
+	vector<retained_mapping> mappings;
+	~rl() { for(size_t i = 0; i < mappings.size(); i++) munmap(mappings[i].address, mappings[i].mapped); }
+} retained_list;
+thread_local retained_list retained;
+
+// accounts of the heap allocations of a thread, added to the ones of the
+// process when the thread ends or a report is made (the kernel allocates
+// from every thread of the parallel engines, so it takes no lock)
+void merge_accounts(memory_account* accounts);
+typedef struct ta {
+	memory_account accounts[NUM_SUBSYSTEMS];
+	~ta() { merge_accounts(accounts); }
+} thread_accounts;
+thread_local thread_accounts heap_accounts;
+
+// returns the number of NUMA nodes with memory in the machine
+int numa_nodes()
+{
+	int nodes = 0;
+	for(int n = 0; n < 1024; n++)
+	{
+		string path = "/sys/devices/system/node/node" + to_string(n);
+		if(access(path.c_str(), F_OK) != 0) break;
+		nodes++;
+	}
+	return nodes > 0 ? nodes : 1;
+}
+
+// reads the list of CPUs of a NUMA node (format "0-3,8-11")
+void numa_node_cpus(int node, cpu_set_t& cpus)
+{
+	CPU_ZERO(&cpus);
+	ifstream cpulist("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+	string list;
+	if(!(cpulist >> list)) return;
+	char* token = strtok(&list[0], ",");
+	while(token != NULL)
+	{
+		int first = atoi(token);
+		int last = first;
+		char* dash = strchr(token, '-');
+		if(dash != NULL) last = atoi(dash + 1);
+		for(int c = first; c <= last && c < CPU_SETSIZE; c++) CPU_SET(c, &cpus);
+		token = strtok(NULL, ",");
+	}
+}
+
+/* MEMORY ACCOUNTING
+ *
+ * Every allocation of this layer is accounted to the subsystem of its name,
+ * and the standard containers of the evaluation (the stacks of the
+ * depth-first traversals, the products of compute_kcuts and the signature
+ * tables) use counted_allocator (see graph.h), which accounts their heap
+ * memory per thread. The peak of a subsystem is the highest amount of memory
+ * it held at once; for the heap memory of several threads, it adds up the
+ * peaks of the threads, so it is an upper bound. The memory of the worker
+ * processes of the partitioned engine is not seen.
+******************************************************************************/
+
+// subsystem of an allocation of this layer, by its name
+int subsystem_of(const char* name)
+{
+	const char* graph[] = {"vertices", "input polarities", "fanout offsets", "fanout targets", "label map", "original labels"};
+	const char* cuts[] = {"cut costs", "cut inputs", "cut records", "cut offsets", "cut origins", "cached winners"};
+	for(int i = 0; i < 6; i++) if(strcmp(name, graph[i]) == 0) return MEMORY_GRAPH;
+	for(int i = 0; i < 6; i++) if(strcmp(name, cuts[i]) == 0) return MEMORY_CUTS;
+	return MEMORY_TEMPORARIES;
+}
+
+// adds bytes taken (or given back, when negative) to an account
+inline void account(memory_account& a, long long bytes)
+{
+	a.live += bytes;
+	if(a.live > a.peak) a.peak = a.live;
+	if(bytes > 0)
+	{
+		a.bytes += bytes;
+		a.count++;
+	}
+}
+
+void count_allocation(int subsystem, size_t bytes)
+{
+	account(heap_accounts.accounts[subsystem], (long long)bytes);
+}
+
+void count_release(int subsystem, size_t bytes)
+{
+	account(heap_accounts.accounts[subsystem], -(long long)bytes);
+}
+
+// adds the accounts of a thread to the ones of the process and clears them
+void merge_accounts(memory_account* accounts)
+{
+	lock_guard<mutex> lock(allocations_lock);
+	for(int i = 0; i < NUM_SUBSYSTEMS; i++)
+	{
+		memory_account& total = memory_accounts[i];
+		if(total.live + accounts[i].peak > total.peak) total.peak = total.live + accounts[i].peak;
+		total.live += accounts[i].live;
+		total.bytes += accounts[i].bytes;
+		total.count += accounts[i].count;
+		accounts[i].live = accounts[i].peak = accounts[i].bytes = accounts[i].count = 0;
+	}
+}
+
+// copies the accounts of the process (with the ones of the calling thread)
+void memory_usage(long long* peak, long long* bytes, long long& count)
+{
+	merge_accounts(heap_accounts.accounts);
+	lock_guard<mutex> lock(allocations_lock);
+	count = 0;
+	for(int i = 0; i < NUM_SUBSYSTEMS; i++)
+	{
+		peak[i] = memory_accounts[i].peak;
+		bytes[i] = memory_accounts[i].bytes;
+		count += memory_accounts[i].count;
+	}
+}
+
+// sets the policies used by the next allocations of the calling thread, and
+// the trace they are recorded in (see trace.cpp)
+void configure_memory(int hugepages, int numa, void* trace)
+{
+	memory_hugepages = hugepages;
+	memory_numa = numa;
+	trace_memory(trace);
+}
+
+// makes the next allocations in POSIX shared memory (NULL goes back to
+// private memory)
+void share_memory(const char* segment_prefix)
+{
+	memory_segment = segment_prefix;
+}
+
+// maps a new POSIX shared memory segment; the name is removed right away, so
+// the segment lives while it is mapped by this process or its children
+void* map_segment(size_t bytes, size_t& mapped, int& pages)
+{
+	int segment;
+	{
+		lock_guard<mutex> lock(allocations_lock);
+		segment = memory_segments++;
+	}
+	string name = string(memory_segment) + "-" + to_string(getpid()) + "-" + to_string(segment);
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if(fd < 0) return NULL;
+	size_t page = sysconf(_SC_PAGESIZE);
+	mapped = (bytes + page - 1) & ~(page - 1);
+	pages = PAGES_4K;
+	void* address = MAP_FAILED;
+	if(ftruncate(fd, mapped) == 0)
+		address = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	shm_unlink(name.c_str());
+	return address == MAP_FAILED ? NULL : address;
+}
+
+// maps anonymous memory, trying 1 GiB and 2 MiB huge pages first (when enabled)
+// and falling back to transparent huge pages and then to regular pages
+void* map_pages(size_t bytes, size_t& mapped, int& pages)
+{
+	void* address = MAP_FAILED;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if(memory_hugepages == HUGEPAGES_ON && bytes >= (1UL << 30))
+	{
+		mapped = (bytes + (1UL << 30) - 1) & ~((1UL << 30) - 1);
+		address = mmap(NULL, mapped, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+		pages = PAGES_1G;
+	}
+	if(address == MAP_FAILED && memory_hugepages == HUGEPAGES_ON && bytes >= (1UL << 21))
+	{
+		mapped = (bytes + (1UL << 21) - 1) & ~((1UL << 21) - 1);
+		address = mmap(NULL, mapped, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+		pages = PAGES_2M;
+	}
+	if(address == MAP_FAILED)
+	{
+		size_t page = sysconf(_SC_PAGESIZE);
+		mapped = (bytes + page - 1) & ~(page - 1);
+		address = mmap(NULL, mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+		pages = PAGES_4K;
+		if(address != MAP_FAILED && memory_hugepages == HUGEPAGES_ON && madvise(address, mapped, MADV_HUGEPAGE) == 0)
+			pages = PAGES_THP;
+	}
+	return address == MAP_FAILED ? NULL : address;
+}
+
+/* REUSE OF THE MAPPINGS OF A THREAD
+ * When a thread processes many graphs one after the other (batch mode), the
+ * mappings of regular pages it frees are kept, and a later allocation of at
+ * most the size of a kept mapping and at least half of it takes it back,
+ * zero-filled: the pages are already resident, so they are neither mapped
+ * nor faulted in again. The mappings kept are not counted by the memory
+ * accounting; they are unmapped when the thread stops keeping them or ends.
+******************************************************************************/
+void retain_memory(bool enabled)
+{
+	retained.enabled = enabled;
+	if(enabled) return;
+	for(size_t i = 0; i < retained.mappings.size(); i++) munmap(retained.mappings[i].address, retained.mappings[i].mapped);
+	retained.mappings.clear();
+}
+
+// takes back the smallest kept mapping that fits (NULL if none does)
+void* reuse_mapping(size_t bytes, size_t& mapped)
+{
+	int best = -1;
+	for(int i = 0; i < (int)retained.mappings.size(); i++)
+	{
+		size_t size = retained.mappings[i].mapped;
+		if(size < bytes || size / 2 > bytes) continue;
+		if(best == -1 || size < retained.mappings[best].mapped) best = i;
+	}
+	if(best == -1) return NULL;
+	void* address = retained.mappings[best].address;
+	mapped = retained.mappings[best].mapped;
+	retained.mappings.erase(retained.mappings.begin() + best);
+	memset(address, 0, bytes);
+	return address;
+}
+
+// keeps a mapping released by the thread, unmapping the oldest one kept when
+// there are too many
+void keep_mapping(void* address, size_t mapped)
+{
+	if(retained.mappings.size() == RETAINED_MAPPINGS)
+	{
+		munmap(retained.mappings[0].address, retained.mappings[0].mapped);
+		retained.mappings.erase(retained.mappings.begin());
+	}
+	retained_mapping m = {address, mapped};
+	retained.mappings.push_back(m);
+}
+
+// touches the pages of a region from one thread pinned to each NUMA node, so
+// that each node gets a contiguous slice of the region
+void first_touch(char* address, size_t bytes, int nodes)
+{
+	vector<thread> workers;
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t slice = (bytes / nodes + page - 1) & ~(page - 1);
+	for(int n = 0; n < nodes; n++)
+	{
+		workers.push_back(thread([=]() {
+			cpu_set_t cpus;
+			numa_node_cpus(n, cpus);
+			if(CPU_COUNT(&cpus) > 0) sched_setaffinity(0, sizeof(cpus), &cpus);
+			for(size_t b = n * slice; b < (n + 1) * slice && b < bytes; b += page)
+				address[b] = 0;
+		}));
+	}
+	for(int n = 0; n < nodes; n++) workers[n].join();
+}
+
+// allocates memory for a large array, applying the configured huge page and
+// NUMA policies; the memory is zero-filled and page aligned
+// returns NULL when the memory is not available
+void* allocate_memory(size_t bytes, const char* name)
+{
+	allocation a;
+	a.name = name;
+	a.subsystem = subsystem_of(name);
+	a.bytes = bytes;
+	a.numa = NUMA_DEFAULT;
+	a.numa_error = 0;
+	a.shared = memory_segment != NULL;
+	a.file = false;
+	a.pages = PAGES_4K;
+	bool plain = memory_segment == NULL && memory_hugepages == HUGEPAGES_OFF && memory_numa == NUMA_DEFAULT;
+	a.address = retained.enabled && plain ? reuse_mapping(bytes > 0 ? bytes : 1, a.mapped) : NULL;
+	if(a.address == NULL && memory_segment != NULL) a.address = map_segment(bytes > 0 ? bytes : 1, a.mapped, a.pages);
+	else if(a.address == NULL) a.address = map_pages(bytes > 0 ? bytes : 1, a.mapped, a.pages);
+	if(a.address == NULL) return NULL;
+
+	int nodes = numa_nodes();
+	if(memory_numa == NUMA_INTERLEAVE && nodes > 1)
+	{
+		unsigned long nodemask = (nodes >= 64) ? ~0UL : (1UL << nodes) - 1;
+		if(syscall(SYS_mbind, a.address, a.mapped, MPOL_INTERLEAVE, &nodemask, sizeof(nodemask) * 8, 0) == 0)
+			a.numa = NUMA_INTERLEAVE;
+		else a.numa_error = errno;
+	}
+	else if(memory_numa == NUMA_FIRSTTOUCH && nodes > 1)
+	{
+		first_touch((char*)a.address, a.mapped, nodes);
+		a.numa = NUMA_FIRSTTOUCH;
+	}
+
+	lock_guard<mutex> lock(allocations_lock);
+	account(memory_accounts[a.subsystem], a.mapped);
+	mapped_bytes += a.mapped;
+	trace_allocation(name, a.mapped, true, mapped_bytes);
+	allocations.push_back(a);
+	return a.address;
+}
+
+// maps a part of a file (offset page aligned) in place of an allocation, as
+// private pages: they can be written without changing the file
+// returns NULL when the file cannot be mapped
+void* map_file(int fd, size_t offset, size_t bytes, const char* name)
+{
+	allocation a;
+	a.name = name;
+	a.subsystem = subsystem_of(name);
+	a.bytes = bytes;
+	a.mapped = bytes > 0 ? bytes : 1;
+	a.pages = PAGES_4K;
+	a.numa = NUMA_DEFAULT;
+	a.numa_error = 0;
+	a.shared = false;
+	a.file = true;
+	a.address = mmap(NULL, a.mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+	if(a.address == MAP_FAILED) return NULL;
+
+	lock_guard<mutex> lock(allocations_lock);
+	account(memory_accounts[a.subsystem], a.mapped);
+	mapped_bytes += a.mapped;
+	trace_allocation(name, a.mapped, true, mapped_bytes);
+	allocations.push_back(a);
+	return a.address;
+}
+
+// releases memory obtained from allocate_memory or map_file
+void free_memory(void* address)
+{
+	lock_guard<mutex> lock(allocations_lock);
+	for(int i = 0; i < allocations.size(); i++)
+		if(allocations[i].address == address)
+		{
+			allocation& a = allocations[i];
+			if(retained.enabled && !a.shared && !a.file && a.pages == PAGES_4K && a.numa == NUMA_DEFAULT) keep_mapping(address, a.mapped);
+			else munmap(address, a.mapped);
+			account(memory_accounts[allocations[i].subsystem], -(long long)allocations[i].mapped);
+			mapped_bytes -= allocations[i].mapped;
+			trace_allocation(allocations[i].name, allocations[i].mapped, false, mapped_bytes);
+			allocations.erase(allocations.begin() + i);
+			return;
+		}
+}
+
+// shows the policies actually obtained for each allocation of the process
+// (the allocations are not tracked per engine, so with several engines, as in
+// a batch or a program using the library, the list holds those of all of them)
+void report_memory_policy()
+{
+	const char* page_names[] = {"4 KiB pages", "transparent huge pages (advised)", "2 MiB huge pages", "1 GiB huge pages"};
+	int nodes = numa_nodes();
+	lock_guard<mutex> lock(allocations_lock);
+	cout << "Memory policy of the allocations of the process, all engines included (" << nodes << " NUMA node" << (nodes > 1 ? "s" : "") << "):" << endl;
+	for(int i = 0; i < allocations.size(); i++)
+	{
+		allocation& a = allocations[i];
+		cout << "  " << a.name << ": " << a.bytes << " bytes, " << (a.shared ? "shared segment, " : "") << (a.file ? "mapped from a file, " : "") << page_names[a.pages] << ", ";
+		if(a.numa == NUMA_INTERLEAVE) cout << "interleaved over " << nodes << " nodes";
+		else if(a.numa == NUMA_FIRSTTOUCH) cout << "first touch by " << nodes << " node-pinned threads";
+		else if(memory_numa != NUMA_DEFAULT && nodes < 2) cout << "default placement (single node)";
+		else if(a.numa_error != 0) cout << "default placement (mbind failed: " << strerror(a.numa_error) << ")";
+		else cout << "default placement";
+		cout << endl;
+	}
+	cout << endl;
+}
@@ -0,0 +1,482 @@
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int mark_cone(cut_engine* e, unsigned char* in_cone);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+void share_memory(const char* segment_prefix);
+
+// whether a vertex of the cone feeds a vertex of the cone of another partition
+inline bool on_boundary(const cut_engine* e, const unsigned char* in_cone, const int* partition, int vertex_index)
+{
+	for(int j = e->fanout_offsets[vertex_index]; j < e->fanout_offsets[vertex_index + 1]; j++)
+	{
+		int fanout_index = e->fanout_targets[j];
+		if(in_cone[fanout_index] && partition[fanout_index] != partition[vertex_index]) return true;
+	}
+	return false;
+}
+
+// change of the number of boundary vertices when a vertex moves to a
+// partition (only the vertex and its children can change)
+int boundary_gain(const cut_engine* e, const unsigned char* in_cone, int* partition, int vertex_index, int target)
+{
+	int I = e->I;
+	int left_index = e->vertices[vertex_index].left;
+	int right_index = e->vertices[vertex_index].right;
+	bool left = left_index >= I && in_cone[left_index];
+	bool right = right_index >= I && in_cone[right_index] && right_index != left_index;
+	int before = on_boundary(e, in_cone, partition, vertex_index)
+		+ (left && on_boundary(e, in_cone, partition, left_index)) + (right && on_boundary(e, in_cone, partition, right_index));
+	int source = partition[vertex_index];
+	partition[vertex_index] = target;
+	int after = on_boundary(e, in_cone, partition, vertex_index)
+		+ (left && on_boundary(e, in_cone, partition, left_index)) + (right && on_boundary(e, in_cone, partition, right_index));
+	partition[vertex_index] = source;
+	return after - before;
+}
+
+/* REFINES THE PARTITIONS
+ *
+ * Grouping the outputs leaves the vertices shared by outputs of different
+ * partitions on the boundary. Each pass visits the vertices of the cone from
+ * the last one down and moves a vertex to the partition of one of its fanouts
+ * or children when that removes boundary vertices and the partition stays
+ * within REFINE_SLACK percent of an even split (or of the largest partition, if
+ * the outputs could not be split that evenly). Stops after REFINE_PASSES passes
+ * or when a pass moves nothing. Any partition is valid: a worker only waits for
+ * vertices of lower index than the one it evaluates.
+******************************************************************************/
+#define REFINE_PASSES 4
+#define REFINE_SLACK  5
+
+void refine_partitions(cut_engine* e, const unsigned char* in_cone, int* partition, int partitions, vector<int>& sizes)
+{
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	long count = 0;
+	int limit = 0;
+	for(int w = 0; w < partitions; w++)
+	{
+		count += sizes[w];
+		limit = max(limit, sizes[w]);
+	}
+	limit = max(limit, (int)((count * (100 + REFINE_SLACK) + 100L * partitions - 1) / (100L * partitions)));
+
+	vector<int> candidates;
+	for(int pass = 0; pass < REFINE_PASSES; pass++)
+	{
+		int moves = 0;
+		for(int i = M - 1; i >= I; i--)
+		{
+			if(!in_cone[i]) continue;
+
+			// the partitions of the neighbours of the vertex
+			candidates.clear();
+			for(int j = e->fanout_offsets[i]; j < e->fanout_offsets[i + 1]; j++)
+				if(in_cone[e->fanout_targets[j]]) candidates.push_back(partition[e->fanout_targets[j]]);
+			if(vertices[i].left >= I && in_cone[vertices[i].left]) candidates.push_back(partition[vertices[i].left]);
+			if(vertices[i].right >= I && in_cone[vertices[i].right]) candidates.push_back(partition[vertices[i].right]);
+			sort(candidates.begin(), candidates.end());
+			candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+			int best = partition[i];
+			int best_gain = 0;
+			for(int c = 0; c < candidates.size(); c++)
+			{
+				int target = candidates[c];
+				if(target == partition[i] || sizes[target] >= limit) continue;
+				int gain = boundary_gain(e, in_cone, partition, i, target);
+				if(gain < best_gain)
+				{
+					best = target;
+					best_gain = gain;
+				}
+			}
+			if(best == partition[i]) continue;
+			sizes[partition[i]]--;
+			sizes[best]++;
+			partition[i] = best;
+			moves++;
+		}
+		if(moves == 0) break;
+	}
+}
+
+/* SPLITS THE CONE OF THE OUTPUTS IN PARTITIONS
+ *
+ * Each vertex of the cone is first given to one output: the outputs claim
+ * their own vertices, and then, from the last vertex down to the first, each
+ * vertex gives its owner to the children not claimed yet. Consecutive outputs
+ * are then grouped in partitions of about the same number of vertices, so the
+ * logic shared by neighbouring outputs tends to stay in the same partition.
+ * The partitions are then refined to reduce the boundary (see
+ * refine_partitions). Gives each boundary vertex (a vertex of a partition feeding vertices of
+ * another partition) its rank among them, -1 to the other vertices, and
+ * returns the number of boundary vertices.
+******************************************************************************/
+int split_in_partitions(cut_engine* e, unsigned char* in_cone, int* partition, int partitions, vector<int>& sizes, int* boundary_rank)
+{
+	int M = e->M;
+	int I = e->I;
+	int O = e->O;
+	int* outputs = e->outputs;
+	vertex* vertices = e->vertices;
+
+	// gives each vertex of the cone to an output
+	for(int i = 0; i < M; i++) partition[i] = -1;
+	for(int i = 0; i < O; i++)
+	{
+		int vertex_index = (outputs[i] >> 1) - 1;
+		if(vertex_index >= I && in_cone[vertex_index] && partition[vertex_index] == -1) partition[vertex_index] = i;
+	}
+	vector<int> output_size(O, 0);
+	for(int i = M - 1; i >= I; i--)
+	{
+		if(!in_cone[i]) continue;
+		output_size[partition[i]]++;
+		int left_index = vertices[i].left;
+		int right_index = vertices[i].right;
+		if(left_index >= I && in_cone[left_index] && partition[left_index] == -1) partition[left_index] = partition[i];
+		if(right_index >= I && in_cone[right_index] && partition[right_index] == -1) partition[right_index] = partition[i];
+	}
+
+	// groups consecutive outputs in balanced partitions
+	int count = 0;
+	for(int i = 0; i < O; i++) count += output_size[i];
+	vector<int> output_partition(O, 0);
+	long accumulated = 0;
+	for(int i = 0; i < O; i++)
+	{
+		output_partition[i] = (int)(accumulated * partitions / (count > 0 ? count : 1));
+		accumulated += output_size[i];
+	}
+	sizes.assign(partitions, 0);
+	for(int i = I; i < M; i++)
+		if(in_cone[i])
+		{
+			partition[i] = output_partition[partition[i]];
+			sizes[partition[i]]++;
+		}
+	refine_partitions(e, in_cone, partition, partitions, sizes);
+
+	// finds and ranks the boundary vertices
+	for(int i = 0; i < M; i++) boundary_rank[i] = -1;
+	for(int i = I; i < M; i++)
+	{
+		if(!in_cone[i]) continue;
+		int left_index = vertices[i].left;
+		int right_index = vertices[i].right;
+		if(left_index >= I && in_cone[left_index] && partition[left_index] != partition[i]) boundary_rank[left_index] = 0;
+		if(right_index >= I && in_cone[right_index] && partition[right_index] != partition[i]) boundary_rank[right_index] = 0;
+	}
+	int boundary = 0;
+	for(int i = I; i < M; i++) if(boundary_rank[i] == 0) boundary_rank[i] = boundary++;
+	return boundary;
+}
+
+/* STORE OF A WORKER
+ * A worker only maps the cuts it needs: the ones of its own vertices and
+ * copies of the ones of the children of its vertices evaluated elsewhere
+ * (inputs, vertices of other partitions and vertices evaluated before), in
+ * index order. The cuts of vertex i are the ones from offsets[i] to
+ * offsets[i+1], as in an adaptive store (see cost_start), so the kernel works
+ * on it unchanged. The winners of the vertices follow the cuts, one per
+ * vertex of the store, relative to their first cut.
+******************************************************************************/
+
+// marks the vertices of the store of a worker in used and sets their
+// offsets; returns the number of cuts and sets the number of vertices
+long layout_partition(const cut_engine* e, int worker, const unsigned char* in_cone, const int* partition, unsigned char* used, long* offsets, int& count)
+{
+	int M = e->M;
+	memset(used, 0, M);
+	for(int i = e->I; i < M; i++)
+	{
+		if(!in_cone[i] || partition[i] != worker) continue;
+		used[i] = 1;
+		if(e->vertices[i].left >= 0) used[e->vertices[i].left] = 1;
+		if(e->vertices[i].right >= 0) used[e->vertices[i].right] = 1;
+	}
+	count = 0;
+	offsets[0] = 0;
+	for(int i = 0; i < M; i++)
+	{
+		offsets[i + 1] = offsets[i] + (used[i] ? cut_slots(e, i) : 0);
+		count += used[i];
+	}
+	return offsets[M];
+}
+
+// bytes of the store of a worker
+inline size_t partition_bytes(int k, long cuts, int count)
+{
+	return (size_t)cuts * sizeof(float) + (size_t)cuts * k * sizeof(int) + (size_t)count * sizeof(int);
+}
+
+// copies a cut list between two stores
+inline void copy_cuts(int k, int slots, const float* from_costs, const int* from_inputs, float* to_costs, int* to_inputs)
+{
+	memcpy(to_costs, from_costs, slots * sizeof(float));
+	memcpy(to_inputs, from_inputs, (size_t)slots * k * sizeof(int));
+}
+
+/* BOUNDARY EXCHANGE
+ * The cut lists of the boundary vertices, in the order of their ranks, live in
+ * one shared segment with a flag per vertex: 0 while it is not evaluated, 1
+ * once its cuts are copied there, 2 while a worker sleeps on the flag (a
+ * futex) waiting for them.
+******************************************************************************/
+typedef struct bx {
+	int* rank;                // rank of each vertex among the boundary vertices (-1: not one)
+	vector<long> offsets;     // first cut of each boundary vertex
+	int* ready;               // flags (shared)
+	float* costs;             // cut lists (shared)
+	int* inputs;
+} boundary_exchange;
+
+// waits until the cuts of a boundary vertex are in the exchange
+inline void wait_for(int* ready)
+{
+	int state = __atomic_load_n(ready, __ATOMIC_ACQUIRE);
+	while(state != 1)
+	{
+		if(state == 0 && !__atomic_compare_exchange_n(ready, &state, 2, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) continue;
+		syscall(SYS_futex, ready, FUTEX_WAIT, 2, NULL, NULL, 0);
+		state = __atomic_load_n(ready, __ATOMIC_ACQUIRE);
+	}
+}
+
+// copies the cuts of a boundary vertex to the exchange and wakes the workers
+// waiting for them
+void publish(cut_engine* e, boundary_exchange& x, int vertex_index)
+{
+	int r = x.rank[vertex_index];
+	copy_cuts(e->k, cut_slots(e, vertex_index), &e->cut_costs[cost_start(e, vertex_index)], &e->cut_inputs[input_start(e, vertex_index)],
+		&x.costs[x.offsets[r]], &x.inputs[(size_t)x.offsets[r] * e->k]);
+	if(__atomic_exchange_n(&x.ready[r], 1, __ATOMIC_RELEASE) == 2) syscall(SYS_futex, &x.ready[r], FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// copies the cuts of a child of another partition from the exchange, once
+// they are there (used becomes 2 when they were copied)
+void receive(cut_engine* e, boundary_exchange& x, unsigned char* used, int vertex_index)
+{
+	if(used[vertex_index] == 2) return;
+	int r = x.rank[vertex_index];
+	wait_for(&x.ready[r]);
+	copy_cuts(e->k, cut_slots(e, vertex_index), &x.costs[x.offsets[r]], &x.inputs[(size_t)x.offsets[r] * e->k],
+		&e->cut_costs[cost_start(e, vertex_index)], &e->cut_inputs[input_start(e, vertex_index)]);
+	used[vertex_index] = 2;
+}
+
+// worker process: evaluates the vertices of a partition in index order in its
+// own store (this process's copy of the engine is switched to it)
+void evaluate_partition(cut_engine* e, int worker, unsigned char* in_cone, int* partition, boundary_exchange& x,
+	void* segment, long cuts, unsigned char* used, long* offsets)
+{
+	int M = e->M;
+	int I = e->I;
+	int k = e->k;
+	float* costs = (float*)segment;
+	int* inputs = (int*)(costs + cuts);
+	int* winners = inputs + (size_t)cuts * k;
+
+	// the cuts evaluated before come from the store of the coordinator
+	for(int i = 0; i < M; i++)
+		if(used[i] && (i < I || !in_cone[i]))
+			copy_cuts(k, offsets[i + 1] - offsets[i], &e->cut_costs[cost_start(e, i)], &e->cut_inputs[input_start(e, i)],
+				&costs[offsets[i]], &inputs[(size_t)offsets[i] * k]);
+	e->cut_costs = costs;
+	e->cut_inputs = inputs;
+	e->cut_offsets = offsets;
+	e->cost_offset = e->p;
+	e->input_offset = e->p * k;
+
+	int position = -1;
+	for(int i = 0; i < M; i++)
+	{
+		if(!used[i]) continue;
+		position++;
+		if(i < I || !in_cone[i] || partition[i] != worker) continue;
+		vertex* v = &e->vertices[i];
+		if(v->left >= I && in_cone[v->left] && partition[v->left] != worker) receive(e, x, used, v->left);
+		if(v->right >= I && in_cone[v->right] && partition[v->right] != worker) receive(e, x, used, v->right);
+		v->winner = compute_kcuts(e, i, v->left, v->right);
+		winners[position] = v->winner == -1 ? -1 : (int)(v->winner - offsets[i]);
+		if(x.rank[i] >= 0) publish(e, x, i);
+	}
+}
+
+// copies the cuts and the winners of the vertices of a worker from its store
+// to the store of the engine
+void stitch_partition(cut_engine* e, int worker, unsigned char* in_cone, int* partition, void* segment, unsigned char* used, long* offsets)
+{
+	int count;
+	long cuts = layout_partition(e, worker, in_cone, partition, used, offsets, count);
+	int k = e->k;
+	float* costs = (float*)segment;
+	int* inputs = (int*)(costs + cuts);
+	int* winners = inputs + (size_t)cuts * k;
+	int position = -1;
+	for(int i = 0; i < e->M; i++)
+	{
+		if(!used[i]) continue;
+		position++;
+		if(i < e->I || !in_cone[i] || partition[i] != worker) continue;
+		copy_cuts(k, offsets[i + 1] - offsets[i], &costs[offsets[i]], &inputs[(size_t)offsets[i] * k],
+			&e->cut_costs[cost_start(e, i)], &e->cut_inputs[input_start(e, i)]);
+		e->vertices[i].winner = winners[position] == -1 ? -1 : cost_start(e, i) + winners[position];
+	}
+}
+
+/* PARTITIONED MULTI-PROCESS EVALUATION
+ *
+ * The cone of the outputs is split in partitions and each partition is
+ * evaluated by a worker process forked from this one (the coordinator).
+ * Each worker has its own store in POSIX shared memory, sized to its
+ * partition and the children it reads from elsewhere, and the cuts of the
+ * boundary vertices are exchanged through one more segment (see above), so
+ * no worker maps the whole cut store. A worker evaluates its vertices in
+ * index order and, before using the cuts of a boundary vertex of another
+ * partition, sleeps on its flag until they are there. Every worker only waits
+ * for vertices of lower index than the one it is evaluating, which the other
+ * workers reach first, so there are no deadlocks. The coordinator waits for
+ * the workers and copies the cuts and the winners of each one into the store
+ * of the engine as it ends. The results are identical to the depth-first
+ * traversal.
+******************************************************************************/
+int evaluate_by_partitions(cut_engine* e)
+{
+	int M = e->M;
+	int k = e->k;
+	int partitions = e->options.partitions;
+	unsigned char* in_cone = (unsigned char*)allocate_memory(M, "cone marks");
+	int* partition = (int*)allocate_memory((size_t)M * sizeof(int), "partitions");
+	unsigned char* used = (unsigned char*)allocate_memory(M, "partition marks");
+	long* offsets = (long*)allocate_memory((size_t)(M + 1) * sizeof(long), "partition offsets");
+	boundary_exchange x;
+	x.rank = (int*)allocate_memory((size_t)M * sizeof(int), "boundary ranks");
+	void* exchange = NULL;
+
+	int status = PK_OK;
+	if(in_cone == NULL || partition == NULL || used == NULL || offsets == NULL || x.rank == NULL)
+		status = fail(e, PK_ERROR_MEMORY, "Failed to allocate the partitions.");
+
+	int count = 0;
+	int boundary = 0;
+	vector<int> sizes;
+	if(status == PK_OK)
+	{
+		count = mark_cone(e, in_cone);
+		boundary = split_in_partitions(e, in_cone, partition, partitions, sizes, x.rank);
+
+		// the exchange of the cuts of the boundary vertices
+		x.offsets.assign(boundary + 1, 0);
+		for(int i = e->I; i < M; i++) if(x.rank[i] >= 0) x.offsets[x.rank[i] + 1] = x.offsets[x.rank[i]] + cut_slots(e, i);
+		long cuts = x.offsets[boundary];
+		share_memory(PARTITION_SEGMENT);
+		exchange = allocate_memory((size_t)boundary * sizeof(int) + (size_t)cuts * sizeof(float) + (size_t)cuts * k * sizeof(int), "boundary cuts");
+		share_memory(NULL);
+		if(exchange == NULL) status = fail(e, PK_ERROR_MEMORY, "Failed to allocate the boundary cuts.");
+		else
+		{
+			x.ready = (int*)exchange;
+			x.costs = (float*)(x.ready + boundary);
+			x.inputs = (int*)(x.costs + cuts);
+		}
+	}
+
+	// forks one worker per partition, each with its own store (the stores of
+	// the workers forked before are unmapped in the new one)
+	cout.flush();
+	vector<pid_t> workers;
+	vector<void*> stores;
+	for(int w = 0; w < partitions && status == PK_OK; w++)
+	{
+		int vertices;
+		long cuts = layout_partition(e, w, in_cone, partition, used, offsets, vertices);
+		share_memory(PARTITION_SEGMENT);
+		void* store = allocate_memory(partition_bytes(k, cuts, vertices), "partition cuts");
+		share_memory(NULL);
+		if(store == NULL)
+		{
+			status = fail(e, PK_ERROR_MEMORY, "Failed to allocate the cuts of partition " + to_string(w) + ".");
+			for(int y = 0; y < workers.size(); y++) kill(workers[y], SIGKILL);
+			break;
+		}
+		stores.push_back(store);
+		pid_t pid = fork();
+		if(pid < 0)
+		{
+			status = fail(e, PK_ERROR_WORKER, "Failed to start the worker process of partition " + to_string(w) + ".");
+			for(int y = 0; y < workers.size(); y++) kill(workers[y], SIGKILL);
+			break;
+		}
+		if(pid == 0)
+		{
+			for(int y = 0; y < w; y++) free_memory(stores[y]);
+			evaluate_partition(e, w, in_cone, partition, x, store, cuts, used, offsets);
+			_exit(0);
+		}
+		workers.push_back(pid);
+	}
+
+	// waits for the workers (only the ones started here, as the engine may
+	// live in a process with other children) and takes the cuts of each one as
+	// it ends; if one fails, the others could wait forever for its boundary
+	// vertices, so they are stopped
+	vector<bool> finished(workers.size(), false);
+	int running = workers.size();
+	while(running > 0)
+	{
+		bool progress = false;
+		for(int w = 0; w < workers.size(); w++)
+		{
+			if(finished[w]) continue;
+			int worker_status = 0;
+			pid_t pid = waitpid(workers[w], &worker_status, status == PK_OK ? WNOHANG : 0);
+			if(pid == 0) continue;
+			finished[w] = true;
+			running--;
+			progress = true;
+			if(status == PK_OK && (pid < 0 || !WIFEXITED(worker_status) || WEXITSTATUS(worker_status) != 0))
+			{
+				status = fail(e, PK_ERROR_WORKER, "A worker process failed.");
+				for(int y = 0; y < workers.size(); y++) if(!finished[y]) kill(workers[y], SIGKILL);
+			}
+			if(status == PK_OK) stitch_partition(e, w, in_cone, partition, stores[w], used, offsets);
+			free_memory(stores[w]);
+			stores[w] = NULL;
+		}
+		if(!progress) usleep(100);
+	}
+
+	if(status == PK_OK && e->verbose)
+	{
+		cout << "Evaluated " << count << " vertices in " << partitions << " worker processes (" << boundary << " boundary vertices)." << endl;
+		for(int w = 0; w < partitions; w++) cout << "  partition " << w << ": " << sizes[w] << " vertices" << endl;
+	}
+
+	for(size_t w = 0; w < stores.size(); w++) free_memory(stores[w]);
+	free_memory(exchange);
+	free_memory(x.rank);
+	free_memory(offsets);
+	free_memory(used);
+	free_memory(partition);
+	free_memory(in_cone);
+	return status;
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+extern const char* phase_names[NUM_PHASES];
+
+// names of the counters, in the order of their constants (see graph.h)
+const char* counter_names[NUM_COUNTERS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses"};
+
+// type and configuration of the event of each counter
+static const unsigned counter_types[NUM_COUNTERS] = {
+	PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+};
+static const unsigned long long counter_configs[NUM_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// closes the counters of an engine
+void close_counters(cut_engine* e)
+{
+	for(int i = 0; i < NUM_COUNTERS; i++)
+	{
+		if(e->counter_fds[i] >= 0) close(e->counter_fds[i]);
+		e->counter_fds[i] = -1;
+	}
+}
+
+/* HARDWARE PERFORMANCE COUNTERS
+ *
+ * With the perf-counters option, one counter per event is opened with
+ * perf_event_open when a graph is loaded, for the user-space code of the
+ * process and of the threads and worker processes created afterwards (the
+ * thread pools and the partitions are created by the engines, after that).
+ * The counters are not grouped, since groups cannot be read with inherited
+ * counters; when the kernel multiplexes them, each value is scaled by the
+ * time its counter was enabled over the time it ran.
+ * A counter that cannot be opened (no PMU in a virtual machine, a CPU without
+ * the event or a perf_event_paranoid setting above 2) is reported as not
+ * available and the others are still read; the counts of each phase are -1
+ * until then.
+******************************************************************************/
+void open_counters(cut_engine* e)
+{
+	close_counters(e);
+	for(int i = 0; i < NUM_PHASES; i++)
+		for(int j = 0; j < NUM_COUNTERS; j++) e->phase_counters[i][j] = -1;
+	if(!e->options.perf_counters) return;
+
+	int opened = 0;
+	int error = 0;
+	for(int i = 0; i < NUM_COUNTERS; i++)
+	{
+		struct perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = counter_types[i];
+		attributes.config = counter_configs[i];
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.inherit = 1;
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		e->counter_fds[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+		if(e->counter_fds[i] >= 0) opened++;
+		else error = errno;
+	}
+	for(int i = 0; i < NUM_PHASES; i++)
+		for(int j = 0; j < NUM_COUNTERS; j++) if(e->counter_fds[j] >= 0) e->phase_counters[i][j] = 0;
+
+	if(e->verbose && opened < NUM_COUNTERS)
+	{
+		bool denied = error == EACCES || error == EPERM;
+		cout << "Hardware performance counters: " << (opened == 0 ? "none" : "some") << " available (" << strerror(error)
+			 << (denied ? "; see /proc/sys/kernel/perf_event_paranoid" : "") << "). ";
+		if(opened > 0)
+		{
+			cout << "Not counted:";
+			for(int i = 0; i < NUM_COUNTERS; i++) if(e->counter_fds[i] < 0) cout << " " << counter_names[i];
+			cout << "." << endl;
+		}
+		else cout << "The phases are only timed." << endl;
+	}
+}
+
+// reads the counters of an engine, scaled when they were multiplexed (-1 for
+// the ones not available)
+void read_counters(const cut_engine* e, double* values)
+{
+	for(int i = 0; i < NUM_COUNTERS; i++)
+	{
+		unsigned long long data[3];
+		values[i] = -1;
+		if(e->counter_fds[i] < 0 || read(e->counter_fds[i], data, sizeof(data)) != sizeof(data)) continue;
+		values[i] = data[2] > 0 && data[2] < data[1] ? (double)data[0] * data[1] / data[2] : (double)data[0];
+	}
+}
+
+// the counters of an engine are open
+bool counting(const cut_engine* e)
+{
+	for(int i = 0; i < NUM_COUNTERS; i++) if(e->counter_fds[i] >= 0) return true;
+	return false;
+}
+
+// shows the counters of each phase with a few ratios (instructions per cycle,
+// misses per thousand instructions)
+void print_counters(const cut_engine* e)
+{
+	if(!counting(e)) return;
+	cout << endl << "Hardware performance counters:" << endl;
+	cout << "  phase      ";
+	for(int i = 0; i < NUM_COUNTERS; i++) cout << " " << string(15 - strlen(counter_names[i]), ' ') << counter_names[i];
+	cout << "     IPC  L1D/KI  LLC/KI" << endl;
+	for(int phase = 0; phase < NUM_PHASES; phase++)
+	{
+		const double* values = e->phase_counters[phase];
+		cout << "  " << phase_names[phase] << string(12 - strlen(phase_names[phase]), ' ');
+		for(int i = 0; i < NUM_COUNTERS; i++)
+		{
+			string value = values[i] >= 0 ? to_string((unsigned long long)values[i]) : "n/a";
+			cout << " " << string(value.size() < 15 ? 15 - value.size() : 0, ' ') << value;
+		}
+		double instructions = values[COUNTER_INSTRUCTIONS];
+		double ratios[3] = {-1, -1, -1};
+		if(instructions >= 0 && values[COUNTER_CYCLES] > 0) ratios[0] = instructions / values[COUNTER_CYCLES];
+		if(instructions > 0 && values[COUNTER_L1D_MISSES] >= 0) ratios[1] = values[COUNTER_L1D_MISSES] * 1000 / instructions;
+		if(instructions > 0 && values[COUNTER_LLC_MISSES] >= 0) ratios[2] = values[COUNTER_LLC_MISSES] * 1000 / instructions;
+		for(int i = 0; i < 3; i++)
+		{
+			char ratio[16];
+			if(ratios[i] >= 0) snprintf(ratio, sizeof(ratio), " %7.2f", ratios[i]);
+			else snprintf(ratio, sizeof(ratio), "     n/a");
+			cout << ratio;
+		}
+		cout << endl;
+	}
+}
@@ -0,0 +1,350 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int vertex_of_label(const cut_engine* e, int label);
+void find_cuts(const cut_engine* e, int vertex_index, float*& costs, int*& inputs, int& p);
+int original_label(const cut_engine* e, int label);
+int winner_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset);
+int compute_cuts(cut_engine* e, bool display);
+
+// arguments of a request at most (a batch of labels)
+#define MAX_ARGUMENTS (1 << 24)
+
+// bytes of replies not sent to a client above which its requests are not
+// read until it reads its replies
+#define OUTPUT_LIMIT (1 << 20)
+
+// set by SIGINT and SIGTERM to stop the server
+volatile sig_atomic_t stop_serving = 0;
+
+void request_stop(int)
+{
+	stop_serving = 1;
+}
+
+// a client: the bytes received and not answered yet, and the replies not
+// sent yet (the sockets are non-blocking, so a slow client never holds up the
+// others)
+typedef struct cn {
+	int fd;
+	vector<char> input;
+	vector<char> output;
+	size_t sent;     // bytes of output already sent
+	bool closing;    // closed once the output is sent (after a bad request)
+	bool ended;      // the client closed its end: closed once the output is sent
+} connection;
+
+void reply_error(connection& c, int status, const string& message);
+
+// appends a reply to the output of a client: the status, the size of the
+// payload and the payload (the size is a 32-bit integer, so a larger payload
+// is replaced by an error)
+void reply(connection& c, int status, const void* payload, size_t bytes)
+{
+	if(bytes > INT_MAX) return reply_error(c, PK_ERROR_ARGUMENT, "The reply would exceed " + to_string(INT_MAX) + " bytes: ask for fewer vertices.");
+	int header[2] = {status, (int)bytes};
+	c.output.insert(c.output.end(), (const char*)header, (const char*)header + sizeof(header));
+	if(bytes > 0) c.output.insert(c.output.end(), (const char*)payload, (const char*)payload + bytes);
+}
+
+void reply_error(connection& c, int status, const string& message)
+{
+	reply(c, status, message.c_str(), message.size());
+}
+
+// reads what a client sent; false when it is gone
+bool receive(connection& c)
+{
+	char buffer[65536];
+	while(true)
+	{
+		ssize_t done = read(c.fd, buffer, sizeof(buffer));
+		if(done > 0) c.input.insert(c.input.end(), buffer, buffer + done);
+		else if(done < 0 && errno == EINTR) continue;
+		else if(done < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+		else return false;
+	}
+}
+
+// sends what the socket of a client takes of its output; false when it is gone
+bool flush(connection& c)
+{
+	while(c.sent < c.output.size())
+	{
+		ssize_t done = send(c.fd, &c.output[c.sent], c.output.size() - c.sent, MSG_NOSIGNAL);
+		if(done > 0) c.sent += done;
+		else if(done < 0 && errno == EINTR) continue;
+		else if(done < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+		else return false;
+	}
+	c.output.clear();
+	c.sent = 0;
+	return true;
+}
+
+// adds a cost to a payload of words
+inline void add_cost(vector<int>& payload, float cost)
+{
+	int word;
+	memcpy(&word, &cost, sizeof(word));
+	payload.push_back(word);
+}
+
+// adds a cut (its cost, its number of leaves and the leaves) to a payload
+void add_cut(const cut_engine* e, vector<int>& payload, float cost, const int* inputs)
+{
+	add_cost(payload, cost);
+	size_t count = payload.size();
+	payload.push_back(0);
+	for(int l = 0; l < e->k; l++)
+		if(inputs[l] != -1) payload.push_back(original_label(e, inputs[l]));
+	payload[count] = payload.size() - count - 1;
+}
+
+// adds the cut list of a vertex; false if the label is not a vertex
+bool add_cut_list(const cut_engine* e, vector<int>& payload, int label)
+{
+	int vertex_index = vertex_of_label(e, label);
+	if(vertex_index < 0) return false;
+	float* costs = NULL;
+	int* inputs = NULL;
+	int p = 0;
+	find_cuts(e, vertex_index, costs, inputs, p);
+	payload.push_back(label);
+	size_t count = payload.size();
+	payload.push_back(0);
+	for(int j = 0; j < p && costs != NULL; j++)
+	{
+		if(costs[j] == -1) continue;
+		add_cut(e, payload, costs[j], &inputs[j * e->k]);
+		payload[count]++;
+	}
+	return true;
+}
+
+/* ANSWERS A REQUEST (see the protocol in priokcuts.h)
+ * The reply is appended to the output of the client.
+******************************************************************************/
+void answer(cut_engine* e, connection& c, int operation, const vector<int>& arguments, bool& shutdown)
+{
+	int count = arguments.size();
+	vector<int> payload;
+	if(operation == PK_SERVE_INFO && count == 0)
+	{
+		int info[6] = {e->label_map != NULL ? e->original_M : e->M, e->I, e->O, e->A, e->k, e->p};
+		payload.assign(info, info + 6);
+	}
+	else if((operation == PK_SERVE_CUTS || operation == PK_SERVE_WINNER) && count == 1)
+	{
+		int label = arguments[0];
+		int vertex_index = vertex_of_label(e, label);
+		float* costs = NULL;
+		int* inputs = NULL;
+		int p = 0;
+		if(vertex_index >= 0) find_cuts(e, vertex_index, costs, inputs, p);
+		if(vertex_index < 0) return reply_error(c, PK_ERROR_ARGUMENT, "Invalid vertex label: " + to_string(label) + ".");
+		if(operation == PK_SERVE_CUTS) add_cut_list(e, payload, label);
+		else if(costs == NULL) return reply_error(c, PK_ERROR_ARGUMENT, "Vertex " + to_string(label) + " has no cuts.");
+		else
+		{
+			int offset = 0;
+			int winner = winner_cut(0, costs, p, offset);
+			int index = 0;
+			for(int j = 0; j < winner; j++) if(costs[j] != -1) index++;
+			payload.push_back(label);
+			payload.push_back(index);
+			add_cut(e, payload, costs[winner], &inputs[winner * e->k]);
+		}
+	}
+	else if(operation == PK_SERVE_BATCH)
+	{
+		payload.push_back(count);
+		for(int i = 0; i < count; i++)
+			if(!add_cut_list(e, payload, arguments[i]))
+				return reply_error(c, PK_ERROR_ARGUMENT, "Invalid vertex label: " + to_string(arguments[i]) + ".");
+	}
+	else if(operation == PK_SERVE_RECOMPUTE && (count == 1 || count == 2))
+	{
+		int p = arguments[0];
+		int k = count == 2 ? arguments[1] : e->k;
+		if(p < 2 || k < 2) return reply_error(c, PK_ERROR_ARGUMENT, "Invalid values of k and p.");
+		if(e->options.stream) return reply_error(c, PK_ERROR_STATE, "The cuts of a graph evaluated in streaming mode cannot be evaluated again.");
+		int previous_p = e->p;
+		int previous_k = e->k;
+		e->p = p;
+		e->k = k;
+		e->options.num_ks = 0;
+		e->options.num_ps = 0;
+		int status = compute_cuts(e, false);
+		if(status != PK_OK)
+		{
+			// the cuts of the previous values are evaluated again, so the
+			// server keeps answering with a valid store
+			string message = e->message;
+			e->p = previous_p;
+			e->k = previous_k;
+			compute_cuts(e, false);
+			return reply_error(c, status, message);
+		}
+		payload.push_back(e->k);
+		payload.push_back(e->p);
+	}
+	else if(operation == PK_SERVE_SHUTDOWN && count == 0) shutdown = true;
+	else return reply_error(c, PK_ERROR_ARGUMENT, "Unknown operation " + to_string(operation) + " with " + to_string(count) + " arguments.");
+
+	reply(c, PK_OK, payload.empty() ? NULL : &payload[0], payload.size() * sizeof(int));
+}
+
+// answers the requests received whole from a client, in order
+int answer_requests(cut_engine* e, connection& c, bool& shutdown)
+{
+	int answered = 0;
+	size_t position = 0;
+	while(!c.closing && !shutdown && c.input.size() - position >= 2 * sizeof(int))
+	{
+		int header[2];
+		memcpy(header, &c.input[position], sizeof(header));
+		if(header[1] < 0 || header[1] > MAX_ARGUMENTS)
+		{
+			reply_error(c, PK_ERROR_ARGUMENT, "Invalid number of arguments.");
+			c.closing = true;
+			break;
+		}
+		size_t bytes = sizeof(header) + (size_t)header[1] * sizeof(int);
+		if(c.input.size() - position < bytes) break;
+		vector<int> arguments(header[1]);
+		if(header[1] > 0) memcpy(&arguments[0], &c.input[position + sizeof(header)], header[1] * sizeof(int));
+		position += bytes;
+		answer(e, c, header[0], arguments, shutdown);
+		answered++;
+	}
+	c.input.erase(c.input.begin(), c.input.begin() + position);
+	return answered;
+}
+
+/* QUERY SERVER
+ *
+ * Once the cuts are computed, the engine answers requests on a Unix domain
+ * socket until a client asks for a shutdown or the process gets SIGINT or
+ * SIGTERM, so a client that asks for the cuts of many sets of vertices does
+ * not load the graph and evaluate the cuts for each one. The clients are
+ * served by a single thread, one request at a time. Their sockets are
+ * non-blocking: poll tells which ones have bytes to read or room to send,
+ * each client has a buffer of the bytes received and one of the replies not
+ * sent yet, and a request is only answered once it was received whole, so a
+ * client that sends part of a request or reads its replies slowly does not
+ * hold up the others. An existing socket at the path is replaced, any other
+ * file is left alone.
+******************************************************************************/
+int serve_cuts(cut_engine* e, const char* path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path)) return fail(e, PK_ERROR_ARGUMENT, "The socket path is too long.");
+	strcpy(address.sun_path, path);
+
+	struct stat status;
+	if(lstat(path, &status) == 0)
+	{
+		if(!S_ISSOCK(status.st_mode)) return fail(e, PK_ERROR_OPEN, "The socket path " + string(path) + " is a file.");
+		unlink(path);
+	}
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(server < 0 || bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server, 16) != 0)
+	{
+		string reason = strerror(errno);
+		if(server >= 0) close(server);
+		return fail(e, PK_ERROR_OPEN, "Failed to listen on " + string(path) + ": " + reason + ".");
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = request_stop;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	if(e->verbose) cout << endl << "Serving the cuts on " << path << "." << endl;
+
+	vector<connection> clients;
+	vector<struct pollfd> events;
+	bool shutdown = false;
+	long requests = 0;
+	while(!stop_serving)
+	{
+		// after a shutdown request, the replies already made are still sent
+		bool pending = false;
+		for(size_t i = 0; i < clients.size(); i++) pending = pending || !clients[i].output.empty();
+		if(shutdown && !pending) break;
+
+		events.resize(clients.size() + 1);
+		events[0].fd = shutdown ? -1 : server;
+		events[0].events = POLLIN;
+		for(size_t i = 0; i < clients.size(); i++)
+		{
+			events[i+1].fd = clients[i].fd;
+			bool reading = !shutdown && !clients[i].closing && !clients[i].ended && clients[i].output.size() < OUTPUT_LIMIT;
+			events[i+1].events = (reading ? POLLIN : 0) | (clients[i].output.empty() ? 0 : POLLOUT);
+		}
+		if(poll(&events[0], events.size(), -1) < 0)
+		{
+			if(errno == EINTR) continue;
+			break;
+		}
+
+		for(size_t i = 0, j = 1; i < clients.size(); j++)
+		{
+			connection& c = clients[i];
+			// a client that closed its end still gets the replies to the
+			// requests it sent whole before: it is kept until they are sent
+			// (or sending fails because it is gone altogether)
+			bool open = true;
+			if(events[j].revents & POLLIN)
+			{
+				c.ended = !receive(c);
+				requests += answer_requests(e, c, shutdown);
+			}
+			else if(events[j].revents & (POLLERR | POLLNVAL)) open = false;
+			else if(events[j].revents & POLLHUP) c.ended = true;
+			if(!c.output.empty() && !flush(c)) open = false;
+			if(open && !((c.closing || c.ended) && c.output.empty()))
+			{
+				i++;
+				continue;
+			}
+			close(c.fd);
+			clients.erase(clients.begin() + i);
+		}
+		if(events[0].revents & POLLIN)
+		{
+			connection c;
+			c.fd = accept(server, NULL, NULL);
+			c.sent = 0;
+			c.closing = false;
+			c.ended = false;
+			if(c.fd >= 0 && fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL) | O_NONBLOCK) == 0) clients.push_back(c);
+			else if(c.fd >= 0) close(c.fd);
+		}
+	}
+
+	for(size_t i = 0; i < clients.size(); i++) close(clients[i].fd);
+	close(server);
+	unlink(path);
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	if(e->verbose) cout << "Server stopped after " << requests << " requests." << endl;
+	return PK_OK;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int enumerate_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+
+// marks the autocut of a vertex in a stored cut list
+#define OWN_LABEL -2
+
+// signatures and cut lists (with the leaves renamed, see below) in flat
+// arrays, found through an open addressing table of positions
+typedef struct st {
+	int key_size;                           // ints per signature
+	temporary_vector<int> keys;
+	temporary_vector<unsigned long long> hashes;
+	temporary_vector<float> costs;          // p per signature
+	temporary_vector<int> inputs;           // p*k per signature
+	temporary_vector<int> winners;          // position of the winner cut, or -1
+	temporary_vector<int> slots;            // signature positions (-1: empty)
+	long hits;
+	long misses;
+	temporary_vector<int> key;              // signature of the vertex being evaluated
+	temporary_vector<int> leaves;           // its leaves, by local name
+	temporary_vector<int> names;            // local name of each vertex as a leaf,
+	temporary_vector<int> stamps;           // valid when its stamp is the current one
+	int stamp;
+} signature_table;
+
+/* STRUCTURAL REUSE OF CUT LISTS
+ *
+ * compute_kcuts only looks at the fanout of a vertex, at its constant
+ * children and at the costs and leaves of the cuts of its children, and the
+ * leaves are only compared with each other. So two vertices whose children
+ * have the same cut lists up to a renaming of the leaves get the same cuts up
+ * to the same renaming. The signature of a vertex is its fanout, its constant
+ * children and the cut lists of its children with each leaf renamed after its
+ * first appearance (constants keep their values, which are below any label);
+ * the signature table keeps the cut list computed for each signature with the
+ * same renaming, and the autocut marked, so the cuts of a vertex with a known
+ * signature are rebuilt by putting its leaves back instead of enumerating the
+ * products.
+******************************************************************************/
+
+// local name of a leaf (labels are at least 2, so the local names are too)
+inline int local_name(signature_table* signatures, int leaf)
+{
+	if(leaf < 2) return leaf;
+	int vertex_index = (leaf >> 1) - 1;
+	if(signatures->stamps[vertex_index] != signatures->stamp)
+	{
+		signatures->stamps[vertex_index] = signatures->stamp;
+		signatures->names[vertex_index] = signatures->leaves.size() + 2;
+		signatures->leaves.push_back(leaf);
+	}
+	return signatures->names[vertex_index];
+}
+
+// appends the cut list of a child to the signature of a vertex (nothing but
+// empty cuts for a constant child, so all the signatures have the same size)
+inline void append_child(cut_engine* e, signature_table* signatures, int child_index, int& next)
+{
+	int p = e->p;
+	int k = e->k;
+	int* key = &signatures->key[0];
+	if(child_index < 0)
+	{
+		for(int l = 0; l < p + p * k; l++) key[next++] = -1;
+		return;
+	}
+	float* costs = &e->cut_costs[(size_t)child_index * e->cost_offset];
+	int* inputs = &e->cut_inputs[(size_t)child_index * e->input_offset];
+	memcpy(&key[next], costs, p * sizeof(float));
+	next += p;
+	for(int l = 0; l < p * k; l++) key[next++] = inputs[l] == -1 ? -1 : local_name(signatures, inputs[l]);
+}
+
+// doubles the table of positions when it is half full
+void grow_slots(signature_table* signatures)
+{
+	int count = signatures->winners.size();
+	if(2 * count < signatures->slots.size()) return;
+	signatures->slots.assign(signatures->slots.empty() ? 1024 : 2 * signatures->slots.size(), -1);
+	size_t mask = signatures->slots.size() - 1;
+	for(int i = 0; i < count; i++)
+	{
+		size_t slot = signatures->hashes[i] & mask;
+		while(signatures->slots[slot] != -1) slot = (slot + 1) & mask;
+		signatures->slots[slot] = i;
+	}
+}
+
+int reuse_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index)
+{
+	signature_table* signatures = (signature_table*)e->signatures;
+	int p = e->p;
+	int k = e->k;
+	int fanout = e->vertices[vertex_index].fanout;
+	if(fanout == 0) return -1;
+
+	// builds and hashes (FNV-1a) the signature of the vertex
+	int key_size = signatures->key_size;
+	int* key = &signatures->key[0];
+	int next = 0;
+	key[next++] = fanout;
+	key[next++] = left_index < 0 ? left_index : 0;
+	key[next++] = right_index < 0 ? right_index : 0;
+	signatures->leaves.clear();
+	signatures->stamp++;
+	append_child(e, signatures, left_index, next);
+	append_child(e, signatures, right_index, next);
+	unsigned long long hash = 14695981039346656037ULL;
+	for(int i = 0; i < key_size; i++) hash = (hash ^ (unsigned)key[i]) * 1099511628211ULL;
+	hash ^= hash >> 32;   // the low bits, which choose the position, depend on the whole key
+
+	// looks for the signature
+	float* costs = &e->cut_costs[(size_t)vertex_index * e->cost_offset];
+	int* inputs = &e->cut_inputs[(size_t)vertex_index * e->input_offset];
+	int label = e->labels != NULL ? e->labels[vertex_index] : (vertex_index + 1) * 2;
+	grow_slots(signatures);
+	size_t mask = signatures->slots.size() - 1;
+	size_t slot = hash & mask;
+	for(; signatures->slots[slot] != -1; slot = (slot + 1) & mask)
+	{
+		int found = signatures->slots[slot];
+		if(signatures->hashes[found] != hash || memcmp(&signatures->keys[(size_t)found * key_size], key, key_size * sizeof(int)) != 0) continue;
+
+		// puts the leaves of the vertex back in the stored cut list
+		memcpy(costs, &signatures->costs[(size_t)found * p], p * sizeof(float));
+		int* stored = &signatures->inputs[(size_t)found * p * k];
+		for(int l = 0; l < p * k; l++)
+		{
+			int leaf = stored[l];
+			if(leaf == OWN_LABEL) inputs[l] = label;
+			else if(leaf >= 2) inputs[l] = signatures->leaves[leaf - 2];
+			else inputs[l] = leaf;
+		}
+		signatures->hits++;
+		int winner = signatures->winners[found];
+		return winner == -1 ? -1 : vertex_index * e->cost_offset + winner;
+	}
+
+	// enumerates the cuts and keeps them with the leaves renamed
+	int winner = enumerate_kcuts(e, vertex_index, left_index, right_index);
+	signatures->slots[slot] = signatures->winners.size();
+	signatures->keys.insert(signatures->keys.end(), key, key + key_size);
+	signatures->hashes.push_back(hash);
+	signatures->costs.insert(signatures->costs.end(), costs, costs + p);
+	for(int l = 0; l < p * k; l++)
+	{
+		int leaf = inputs[l];
+		signatures->inputs.push_back(leaf == label ? OWN_LABEL : leaf == -1 ? -1 : local_name(signatures, leaf));
+	}
+	signatures->winners.push_back(winner == -1 ? -1 : winner - vertex_index * e->cost_offset);
+	signatures->misses++;
+	return winner;
+}
+
+// starts reusing the cuts of structurally identical fanins
+void create_signatures(cut_engine* e)
+{
+	signature_table* signatures = new signature_table();
+	signatures->key_size = 3 + 2 * (e->p + e->p * e->k);
+	signatures->key.resize(signatures->key_size);
+	signatures->names.resize(e->M);
+	signatures->stamps.assign(e->M, 0);
+	signatures->stamp = 0;
+	signatures->hits = 0;
+	signatures->misses = 0;
+	e->signatures = signatures;
+}
+
+// stops reusing cuts, reporting how many vertices reused them
+void release_signatures(cut_engine* e)
+{
+	signature_table* signatures = (signature_table*)e->signatures;
+	if(signatures == NULL) return;
+	long evaluated = signatures->hits + signatures->misses;
+	long permille = evaluated > 0 ? signatures->hits * 1000 / evaluated : 0;
+	if(e->verbose)
+		cout << "Reused the cuts of " << signatures->hits << " of " << evaluated << " vertices with known fanin signatures (hit rate "
+			 << permille / 10 << "." << permille % 10 << "%, " << signatures->winners.size() << " signatures)." << endl;
+	delete signatures;
+	e->signatures = NULL;
+}
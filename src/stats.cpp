@@ -0,0 +1,127 @@
+#include <iostream>
+#include <cstring>
+#include <mutex>
+#include "graph.h"
+using namespace std;
+
+/* STATISTICS OF THE CUT ENUMERATION
+ *
+ * Built with -DPK_STATS (make STATS=1), enumerate_kcuts counts in the
+ * statistics of its thread the pairs of cuts of the children it visits, what
+ * happens to each product (rejected for having more than k leaves, placed in
+ * an empty position, placed over a cut of higher cost or discarded), where
+ * the autocut goes, the number of leaves of each product and the number of
+ * cuts each vertex keeps. The statistics of a thread are added to the ones of
+ * the process when the thread ends or a report is made. They are totals of
+ * the process, never cleared: the engines evaluated at the same time on other
+ * threads (or one after the other in batch mode) add to the same counts, and
+ * the command line, which evaluates one graph, reports them at its end.
+ * Without PK_STATS these functions do nothing and the kernel has no counters
+ * at all.
+******************************************************************************/
+#ifdef PK_STATS
+
+// statistics of the process
+kernel_statistics total_statistics;
+mutex statistics_lock;
+
+// adds the statistics of a thread to the ones of the process and clears them
+void merge_statistics(kernel_statistics& statistics)
+{
+	lock_guard<mutex> lock(statistics_lock);
+	long long* total = (long long*)&total_statistics;
+	long long* counters = (long long*)&statistics;
+	for(size_t i = 0; i < sizeof(kernel_statistics) / sizeof(long long); i++) total[i] += counters[i];
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+typedef struct ts {
+	kernel_statistics statistics;
+	~ts() { merge_statistics(statistics); }
+} thread_statistics_holder;
+thread_local thread_statistics_holder statistics_holder;
+
+kernel_statistics& thread_statistics()
+{
+	return statistics_holder.statistics;
+}
+
+// share of a part of a total, in percent
+inline double share(long long part, long long total)
+{
+	return total > 0 ? part * 100.0 / total : 0;
+}
+
+// shows the buckets of a histogram up to the last one not empty
+void print_histogram(const char* name, const long long* histogram, long long total)
+{
+	int last = STATS_BUCKETS - 1;
+	while(last > 0 && histogram[last] == 0) last--;
+	cout << "  " << name << ":";
+	for(int i = 0; i <= last; i++)
+	{
+		if(histogram[i] == 0) continue;
+		char bucket[64];
+		snprintf(bucket, sizeof(bucket), " %d%s: %lld (%.1f%%)", i, i == STATS_BUCKETS - 1 ? "+" : "", histogram[i], share(histogram[i], total));
+		cout << bucket;
+	}
+	cout << endl;
+}
+
+#endif
+
+// shows the statistics of the enumeration since the process started
+void print_statistics()
+{
+#ifdef PK_STATS
+	merge_statistics(thread_statistics());
+	lock_guard<mutex> lock(statistics_lock);
+	const kernel_statistics& s = total_statistics;
+	long long visited = s.pairs + s.empty_pairs;
+	long long autocuts = s.autocut_fills + s.autocut_replacements + s.loser_evictions;
+	char line[256];
+	cout << endl << "Cut enumeration statistics:" << endl;
+	cout << "  vertices enumerated: " << s.vertices << endl;
+	snprintf(line, sizeof(line), "  pairs of cuts: %lld visited, %lld with an empty position (%.1f%%), %lld products",
+		visited, s.empty_pairs, share(s.empty_pairs, visited), s.pairs);
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  products: %lld rejected for more than k leaves (%.1f%%), %lld in empty positions (%.1f%%),",
+		s.rejected, share(s.rejected, s.pairs), s.fills, share(s.fills, s.pairs));
+	cout << line << endl;
+	snprintf(line, sizeof(line), "            %lld over cuts of higher cost (%.1f%%), %lld discarded for lack of a position (%.1f%%)",
+		s.replacements, share(s.replacements, s.pairs), s.discarded, share(s.discarded, s.pairs));
+	cout << line << endl;
+	snprintf(line, sizeof(line), "  autocuts: %lld in empty positions (%.1f%%), %lld over cuts of higher cost (%.1f%%), %lld over the loser (%.1f%%)",
+		s.autocut_fills, share(s.autocut_fills, autocuts), s.autocut_replacements, share(s.autocut_replacements, autocuts),
+		s.loser_evictions, share(s.loser_evictions, autocuts));
+	cout << line << endl;
+	print_histogram("leaves per product", s.leaves, s.pairs);
+	print_histogram("cuts kept per vertex", s.occupancy, s.vertices);
+#endif
+}
+
+// adds the statistics to the JSON line of the metrics (nothing without
+// PK_STATS)
+void print_statistics_json()
+{
+#ifdef PK_STATS
+	merge_statistics(thread_statistics());
+	lock_guard<mutex> lock(statistics_lock);
+	const kernel_statistics& s = total_statistics;
+	cout << ",\"kernel\":{\"vertices\":" << s.vertices << ",\"pairs\":" << s.pairs << ",\"empty_pairs\":" << s.empty_pairs
+		 << ",\"rejected\":" << s.rejected << ",\"discarded\":" << s.discarded << ",\"fills\":" << s.fills
+		 << ",\"replacements\":" << s.replacements << ",\"autocut_fills\":" << s.autocut_fills
+		 << ",\"autocut_replacements\":" << s.autocut_replacements << ",\"loser_evictions\":" << s.loser_evictions;
+	const long long* histograms[2] = {s.leaves, s.occupancy};
+	const char* names[2] = {"leaves", "occupancy"};
+	for(int h = 0; h < 2; h++)
+	{
+		int last = STATS_BUCKETS - 1;
+		while(last > 0 && histograms[h][last] == 0) last--;
+		cout << ",\"" << names[h] << "\":[";
+		for(int i = 0; i <= last; i++) cout << (i > 0 ? "," : "") << histograms[h][i];
+		cout << "]";
+	}
+	cout << "}";
+#endif
+}
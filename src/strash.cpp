@@ -0,0 +1,167 @@
+#include <iostream>
+#include <cstring>
+#include <unordered_map>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+
+/* STRUCTURAL HASHING AND REMOVAL OF UNREACHABLE LOGIC
+ *
+ * The vertices are visited in index order (children first). The children of
+ * each AND vertex are replaced by the vertices that represent them, and the
+ * pair of children, with their polarities (kept by the reader for this pass),
+ * ordered by literal (so the same vertex with both polarities gives one
+ * pair whatever the order in the file), is looked up in a hash table: a vertex whose pair is already there computes
+ * the same function and is merged into the vertex found.
+ * Then only the AND vertices reachable from the outputs are kept, renumbered
+ * in the same order after the inputs, and the fanouts are counted again.
+ * The label in the reduced graph of each original vertex (0 if it was removed)
+ * and the original label of each vertex kept are saved, so the results are
+ * shown with the labels of the file.
+******************************************************************************/
+int strash_graph(cut_engine* e)
+{
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	int* representative = (int*)allocate_memory((size_t)M * sizeof(int), "strash representatives");
+	unsigned char* reachable = (unsigned char*)allocate_memory(M, "strash marks");
+	int* label_map = (int*)allocate_memory((size_t)M * sizeof(int), "label map");
+	if(representative == NULL || reachable == NULL || label_map == NULL)
+	{
+		free_memory(representative);
+		free_memory(reachable);
+		free_memory(label_map);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the structural hashing tables.");
+	}
+
+	// merges the AND vertices with the same pair of children
+	unordered_map<long long, int> pairs;
+	pairs.reserve(M - I);
+	int merged = 0;
+	for(int i = 0; i < I; i++) representative[i] = i;
+	for(int i = I; i < M; i++)
+	{
+		vertex* v = &vertices[i];
+		int left_index = v->left >= 0 ? representative[v->left] : v->left;
+		int right_index = v->right >= 0 ? representative[v->right] : v->right;
+		int left_literal = left_index * 2 + (e->polarities[i] & 1);
+		int right_literal = right_index * 2 + (e->polarities[i] >> 1);
+		if(left_literal < right_literal)
+		{
+			int index = left_index;
+			left_index = right_index;
+			right_index = index;
+			int literal = left_literal;
+			left_literal = right_literal;
+			right_literal = literal;
+		}
+		v->left = left_index;
+		v->right = right_index;
+		long long pair = (long long)((unsigned long long)(unsigned)left_literal << 32 | (unsigned)right_literal);
+		unordered_map<long long, int>::iterator found = pairs.find(pair);
+		if(found != pairs.end())
+		{
+			representative[i] = found->second;
+			merged++;
+		}
+		else
+		{
+			representative[i] = i;
+			pairs[pair] = i;
+		}
+	}
+
+	// marks the vertices reachable from the outputs
+	for(int i = 0; i < I; i++) reachable[i] = 1;
+	for(int i = 0; i < e->O; i++)
+	{
+		int vertex_index = (e->outputs[i] >> 1) - 1;
+		if(vertex_index >= I) reachable[representative[vertex_index]] = 1;
+	}
+	for(int i = M - 1; i >= I; i--)
+	{
+		if(!reachable[i]) continue;
+		if(vertices[i].left >= I) reachable[vertices[i].left] = 1;
+		if(vertices[i].right >= I) reachable[vertices[i].right] = 1;
+	}
+
+	// renumbers the vertices kept, moving them down in place (a vertex never
+	// moves above its old index, and its children were moved before it)
+	int kept = I;
+	for(int i = 0; i < I; i++) label_map[i] = (i + 1) << 1;
+	for(int i = I; i < M; i++)
+	{
+		if(representative[i] != i || !reachable[i]) continue;
+		vertex v = vertices[i];
+		if(v.left >= I) v.left = (label_map[v.left] >> 1) - 1;
+		if(v.right >= I) v.right = (label_map[v.right] >> 1) - 1;
+		vertices[kept] = v;
+		label_map[i] = (kept + 1) << 1;
+		kept++;
+	}
+	for(int i = I; i < M; i++) label_map[i] = reachable[representative[i]] ? label_map[representative[i]] : 0;
+	int removed = M - kept - merged;
+
+	// the original label of each vertex kept
+	int* original_labels = (int*)allocate_memory((size_t)kept * sizeof(int), "original labels");
+	free_memory(representative);
+	free_memory(reachable);
+	free_memory(e->polarities);
+	e->polarities = NULL;
+	if(original_labels == NULL)
+	{
+		free_memory(label_map);
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate the structural hashing tables.");
+	}
+	for(int i = M - 1; i >= 0; i--) if(label_map[i] != 0) original_labels[(label_map[i] >> 1) - 1] = (i + 1) << 1;
+
+	// the outputs and the fanouts of the reduced graph
+	for(int i = 0; i < e->O; i++)
+		if(e->outputs[i] >= 2) e->outputs[i] = label_map[(e->outputs[i] >> 1) - 1] | (e->outputs[i] & 1);
+	for(int i = 0; i < kept; i++) vertices[i].fanout = 0;
+	for(int i = I; i < kept; i++)
+	{
+		if(vertices[i].left >= 0) vertices[vertices[i].left].fanout++;
+		if(vertices[i].right >= 0) vertices[vertices[i].right].fanout++;
+	}
+	for(int i = 0; i < e->O; i++) if(e->outputs[i] >= 2) vertices[(e->outputs[i] >> 1) - 1].fanout++;
+
+	// moves the vertices kept to an array of their size
+	vertex* reduced = (vertex*)allocate_memory((size_t)kept * sizeof(vertex), "vertices");
+	if(reduced != NULL)
+	{
+		memcpy(reduced, vertices, (size_t)kept * sizeof(vertex));
+		free_memory(vertices);
+		e->vertices = reduced;
+		e->capacity = kept;
+	}
+
+	if(e->verbose)
+		cout << "Structural hashing: merged " << merged << " duplicate AND vertices and removed " << removed
+			 << " unreachable ones (" << M << " to " << kept << " vertices)." << endl << endl;
+	e->original_M = M;
+	e->label_map = label_map;
+	e->original_labels = original_labels;
+	e->M = kept;
+	e->A = kept - I;
+	return PK_OK;
+}
+
+// label in the reduced graph of a vertex given by its original label (the
+// label itself without structural hashing, 0 if the vertex was removed)
+int reduced_label(const cut_engine* e, int label)
+{
+	if(e->label_map == NULL || label < 2) return label;
+	return e->label_map[(label >> 1) - 1] | (label & 1);
+}
+
+// original label of a vertex or a leaf given by its label in the graph
+int original_label(const cut_engine* e, int label)
+{
+	if(e->original_labels == NULL || label < 2) return label;
+	return e->original_labels[(label >> 1) - 1] | (label & 1);
+}
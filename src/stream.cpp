@@ -0,0 +1,208 @@
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int read_graph(cut_engine* e, istream& input_file);
+int initialize_cuts(cut_engine* e);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+double begin_phase(cut_engine* e, int phase);
+void end_phase(cut_engine* e, int phase, double start);
+int mark_fanin(cut_engine* e, unsigned char* in_cone, bool unevaluated_only);
+
+// vertices the consumer waits for at a time when it catches up with the
+// reader, so it is woken once per batch and not once per vertex
+#define STREAM_BATCH 256
+
+// state of the pipeline of an engine: the consumer sleeps on decoded (a
+// futex) until it reaches wanted, and the reader wakes it then; both are
+// sequentially consistent, so either the reader sees wanted or the consumer
+// sees the vertices decoded
+typedef struct sp {
+	bool pipelined;
+	atomic<int> decoded;
+	atomic<int> wanted;     // vertices decoded the consumer sleeps for (0: it does not sleep)
+	atomic<bool> aborted;   // the reader stopped on an error
+	thread* consumer;
+} stream_pipeline;
+
+// wakes the consumer sleeping on the vertices decoded
+inline void wake_consumer(stream_pipeline* pipeline)
+{
+	pipeline->wanted.store(0);
+	syscall(SYS_futex, (int*)&pipeline->decoded, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// evaluates the cuts of an AND vertex without dividing the costs by the fanout
+inline void evaluate_decoded(cut_engine* e, int vertex_index)
+{
+	vertex* v = &e->vertices[vertex_index];
+	v->winner = compute_kcuts(e, vertex_index, v->left, v->right);
+}
+
+// consumer thread: evaluates the AND vertices as soon as they are decoded
+void consume_decoded(cut_engine* e)
+{
+	stream_pipeline* pipeline = (stream_pipeline*)e->stream;
+	for(int i = e->I; i < e->M; i++)
+	{
+		if(pipeline->decoded.load(memory_order_acquire) <= i)
+		{
+			int target = i + STREAM_BATCH < e->M ? i + STREAM_BATCH : e->M;
+			pipeline->wanted.store(target);
+			int decoded = pipeline->decoded.load();
+			while(decoded < target && !pipeline->aborted.load())
+			{
+				syscall(SYS_futex, (int*)&pipeline->decoded, FUTEX_WAIT_PRIVATE, decoded, NULL, NULL, 0);
+				decoded = pipeline->decoded.load();
+			}
+			pipeline->wanted.store(0);
+			if(decoded <= i) return;
+		}
+		evaluate_decoded(e, i);
+	}
+}
+
+// hook called by the reader once the inputs and outputs are known
+void stream_graph_allocated(cut_engine* e)
+{
+	stream_pipeline* pipeline = (stream_pipeline*)e->stream;
+	if(initialize_cuts(e) != PK_OK) return;
+	e->cut_origins = (int*)allocate_memory((size_t)e->M * e->p * sizeof(int), "cut origins");
+	if(e->cut_origins == NULL)
+	{
+		fail(e, PK_ERROR_MEMORY, "Failed to allocate the cut origins.");
+		return;
+	}
+	e->defer_normalization = true;
+	if(pipeline->pipelined) pipeline->consumer = new thread(consume_decoded, e);
+}
+
+// hook called by the reader after each AND vertex
+void stream_vertex_decoded(cut_engine* e, int vertex_index)
+{
+	stream_pipeline* pipeline = (stream_pipeline*)e->stream;
+	if(!pipeline->pipelined)
+	{
+		evaluate_decoded(e, vertex_index);
+		return;
+	}
+	pipeline->decoded.store(vertex_index + 1);
+	int wanted = pipeline->wanted.load();
+	if(wanted > 0 && vertex_index + 1 >= wanted) wake_consumer(pipeline);
+}
+
+// returns the cost of the product of the j-th cut of the left child and the
+// z-th cut of the right child of a vertex, divided by the fanout of the vertex
+inline float product_cost(cut_engine* e, vertex* v, int origin, float fanout)
+{
+	int j = origin / e->p;
+	int z = origin % e->p;
+	float left_cut_cost = v->left >= 0 ? e->cut_costs[(size_t)v->left * e->cost_offset + j] : 0.0;
+	float right_cut_cost = v->right >= 0 ? e->cut_costs[(size_t)v->right * e->cost_offset + z] : 0.0;
+	return (left_cut_cost + right_cut_cost) / fanout;
+}
+
+/* STREAMING EVALUATION
+ *
+ * AIGER lists the AND vertices in topological order, so the cuts of a vertex
+ * can be evaluated as soon as it is decoded, while the rest of the file is
+ * still being read (on a second thread when more than one thread is allowed,
+ * which sleeps when it catches up with the reader and is woken once
+ * STREAM_BATCH more vertices are decoded).
+ * The fanouts are only final at the end of the file, so the cuts are chosen
+ * with costs not divided by the fanout, and each cut remembers its origin
+ * (which pair of child cuts, or which product the autocut was built on).
+ * A second pass in index order then recomputes every cost with the final
+ * fanouts, exactly as compute_kcuts would for those cuts. This is a different
+ * heuristic from the engines: the cut costs are exact, but the cuts kept are
+ * not the ones the engines keep by ranking the products with the normalized
+ * costs (most vertices of a large graph keep another set), and matching them
+ * would mean keeping every product until the fanouts are known.
+ * All the AND vertices are evaluated as they are read, so a cone, an engine,
+ * the structural hashing or a cache are rejected when the graph is loaded; the ones the outputs do not reach are discarded at the
+ * end, so the same vertices have cuts as with the engines.
+******************************************************************************/
+int evaluate_while_loading(cut_engine* e, istream& input_file)
+{
+	stream_pipeline pipeline;
+	pipeline.pipelined = e->options.threads > 1;
+	pipeline.decoded.store(0);
+	pipeline.wanted.store(0);
+	pipeline.aborted.store(false);
+	pipeline.consumer = NULL;
+	e->stream = &pipeline;
+	e->graph_allocated = stream_graph_allocated;
+	e->vertex_decoded = stream_vertex_decoded;
+
+	int status = read_graph(e, input_file);
+
+	// the consumer stops waiting for vertices that will never come
+	if(pipeline.consumer != NULL)
+	{
+		// (decoded changes too, so a consumer about to sleep does not)
+		if(status != PK_OK)
+		{
+			pipeline.aborted.store(true);
+			pipeline.decoded.store(-1);
+			wake_consumer(&pipeline);
+		}
+		pipeline.consumer->join();
+		delete pipeline.consumer;
+	}
+
+	e->stream = NULL;
+	e->graph_allocated = NULL;
+	e->vertex_decoded = NULL;
+	e->defer_normalization = false;
+	if(status != PK_OK) return status;
+
+	// divides the costs by the final fanouts (the evaluation itself is timed
+	// with the decoding)
+	double start = begin_phase(e, PHASE_ENUMERATION);
+	unsigned char* in_cone = (unsigned char*)allocate_memory(e->M, "cone marks");
+	if(in_cone == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the cone marks.");
+	mark_fanin(e, in_cone, false);
+	int p = e->p;
+	int discarded = 0;
+	for(int i = e->I; i < e->M; i++)
+	{
+		vertex* v = &e->vertices[i];
+		if(!in_cone[i])
+		{
+			v->winner = -1;
+			discarded++;
+			continue;
+		}
+		float fanout = (float)v->fanout;
+		for(int l = 0; l < p; l++)
+		{
+			float* cost = &e->cut_costs[(size_t)i * e->cost_offset + l];
+			if(*cost == -1) continue;
+			int origin = e->cut_origins[(size_t)i * p + l];
+			if(origin >= 0) *cost = product_cost(e, v, origin, fanout);
+			else if(origin == -1) *cost = -1 + (1.0 / fanout);
+			else *cost = product_cost(e, v, -origin - 2, fanout) + (1.0 / fanout);
+		}
+	}
+
+	free_memory(in_cone);
+	end_phase(e, PHASE_ENUMERATION, start);
+
+	if(e->verbose)
+		cout << "Evaluated " << e->M - e->I << " AND vertices while decoding"
+			 << (pipeline.pipelined ? " (pipelined on 2 threads)" : "") << ", " << discarded << " not reached by the outputs discarded." << endl;
+
+	free_memory(e->cut_origins);
+	e->cut_origins = NULL;
+	e->computed = true;
+	return PK_OK;
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+int compute_kcuts(cut_engine* e, int vertex_index, int left_index, int right_index);
+int mark_cone(cut_engine* e, unsigned char* in_cone);
+void* allocate_memory(size_t bytes, const char* name);
+void free_memory(void* address);
+
+// how many vertices ahead the cuts of the children are prefetched
+#define PREFETCH_DISTANCE 8
+
+// prefetches the cuts of the children of a vertex
+inline void prefetch_children(cut_engine* e, int vertex_index)
+{
+	int left_index = e->vertices[vertex_index].left;
+	int right_index = e->vertices[vertex_index].right;
+	if(left_index >= 0)
+	{
+		__builtin_prefetch(&e->cut_costs[cost_start(e, left_index)]);
+		__builtin_prefetch(&e->cut_inputs[input_start(e, left_index)]);
+	}
+	if(right_index >= 0)
+	{
+		__builtin_prefetch(&e->cut_costs[cost_start(e, right_index)]);
+		__builtin_prefetch(&e->cut_inputs[input_start(e, right_index)]);
+	}
+}
+
+/* TOPOLOGICAL SWEEP
+ *
+ * AIGER lists the children of a vertex before the vertex, so visiting the AND
+ * vertices by index evaluates every child before its parents, with no stack
+ * and no test of the children. The cuts of the children of the vertex
+ * PREFETCH_DISTANCE positions ahead are prefetched while the current vertex
+ * is evaluated.
+ * The transitive fanin of the outputs is marked first and only the marked
+ * vertices are evaluated, exactly as in the depth-first traversal (a vertex
+ * with fanout that only feeds logic the outputs do not reach is skipped).
+******************************************************************************/
+int evaluate_by_sweep(cut_engine* e)
+{
+	int M = e->M;
+	int I = e->I;
+	vertex* vertices = e->vertices;
+	unsigned char* in_cone = (unsigned char*)allocate_memory(M, "cone marks");
+	if(in_cone == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate the cone marks.");
+	int count = mark_cone(e, in_cone);
+
+	for(int i = I; i < M; i++)
+	{
+		if(i + PREFETCH_DISTANCE < M) prefetch_children(e, i + PREFETCH_DISTANCE);
+		if(!in_cone[i]) continue;
+		vertex* v = &vertices[i];
+		v->winner = compute_kcuts(e, i, v->left, v->right);
+	}
+
+	if(e->verbose) cout << "Evaluated " << count << " of " << M - I << " AND vertices in index order." << endl;
+
+	free_memory(in_cone);
+	return PK_OK;
+}
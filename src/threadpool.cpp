@@ -0,0 +1,80 @@
+#include "threadpool.h"
+using namespace std;
+
+thread_pool::thread_pool(int threads)
+{
+	job = NULL;
+	next = 0;
+	last = 0;
+	grain = 1;
+	generation = 0;
+	active = 0;
+	stopping = false;
+	for(int i = 1; i < threads; i++) workers.push_back(thread(&thread_pool::work, this));
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		unique_lock<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(int i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+// takes chunks of the current job until there is none left
+void thread_pool::run_chunks()
+{
+	while(true)
+	{
+		int first = next.fetch_add(grain);
+		if(first >= last) return;
+		int end = first + grain < last ? first + grain : last;
+		(*job)(first, end);
+	}
+}
+
+// worker loop: waits for a new job, helps to run it and reports when done
+void thread_pool::work()
+{
+	unsigned seen = 0;
+	while(true)
+	{
+		unique_lock<mutex> guard(lock);
+		wake.wait(guard, [&]() { return stopping || generation != seen; });
+		if(stopping) return;
+		seen = generation;
+		guard.unlock();
+		run_chunks();
+		guard.lock();
+		if(--active == 0) done.notify_all();
+	}
+}
+
+void thread_pool::parallel_for(int begin, int end, int grain, const function<void(int, int)>& body)
+{
+	if(grain < 1) grain = 1;
+
+	// small jobs are not worth waking up the workers
+	if(workers.empty() || end - begin <= grain)
+	{
+		if(begin < end) body(begin, end);
+		return;
+	}
+
+	{
+		unique_lock<mutex> guard(lock);
+		job = &body;
+		next = begin;
+		last = end;
+		this->grain = grain;
+		active = workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	run_chunks();
+
+	unique_lock<mutex> guard(lock);
+	done.wait(guard, [&]() { return active == 0; });
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+size_t cut_store_bytes(const cut_engine* e);
+int lazy_evaluated(const cut_engine* e);
+void read_counters(const cut_engine* e, double* values);
+bool counting(const cut_engine* e);
+extern const char* counter_names[NUM_COUNTERS];
+void memory_usage(long long* peak, long long* bytes, long long& count);
+void print_statistics_json();
+void trace_span(const cut_engine* e, const char* name, const char* category, double start, double end, const string& args);
+void flush_kernel_batch();
+
+// names of the phases, in the order of their constants (see graph.h)
+const char* phase_names[NUM_PHASES] = {"header", "decode", "fanout", "init", "enumeration", "output"};
+
+// names of the engines, in the order of their constants
+const char* engine_names[] = {"dfs", "levels", "dag", "sweep", "partitions"};
+
+// names of the subsystems of the memory accounting, in the order of their
+// constants
+const char* subsystem_names[NUM_SUBSYSTEMS] = {"graph", "cuts", "stack", "temporaries"};
+
+// returns the time of a monotonic clock, in seconds (the elapsed time, unlike
+// the processor time of clock(), which adds up the time of every thread)
+double wall_time()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// starts a phase of an engine: reads its counters and returns the time
+double begin_phase(cut_engine* e, int phase)
+{
+	if(counting(e)) read_counters(e, e->counter_starts[phase]);
+	return wall_time();
+}
+
+// adds the time elapsed since start (and the counts since the phase began)
+// to a phase of an engine, and its span to the trace
+void end_phase(cut_engine* e, int phase, double start)
+{
+	double end = wall_time();
+	e->phase_seconds[phase] += end - start;
+	if(e->trace != NULL)
+	{
+		if(phase == PHASE_ENUMERATION) flush_kernel_batch();
+		trace_span(e, phase_names[phase], "phase", start, end, "");
+	}
+	if(!counting(e)) return;
+	double values[NUM_COUNTERS];
+	read_counters(e, values);
+	for(int i = 0; i < NUM_COUNTERS; i++)
+		if(values[i] >= 0) e->phase_counters[phase][i] += values[i] - e->counter_starts[phase][i];
+}
+
+// returns the peak resident memory of the process, in bytes
+size_t peak_memory()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return (size_t)usage.ru_maxrss * 1024;
+}
+
+// memory predicted by the model of the README for the graph of an engine:
+// 16*M bytes for the vertices, the cut store (4*(k+1)*p*M bytes with the
+// split layout, see cut_store_bytes), 4*M bytes of auxiliary data in the
+// worst case and the fanout lists, counters and marks of the dag engine
+size_t predicted_memory(const cut_engine* e)
+{
+	size_t M = e->M;
+	size_t cuts = e->cut_costs != NULL ? cut_store_bytes(e) : M * (e->k + 1) * e->p * 4;
+	if(e->cut_offsets != NULL) cuts += (M + 1) * sizeof(long);
+	size_t dag = e->options.engine == ENGINE_DAG ? 4 * M + 8 * (size_t)e->A + 5 * M : 0;
+	return 16 * M + cuts + 4 * M + dag;
+}
+
+// shows the memory accounted to each subsystem, the number of allocations and
+// the peak resident memory of the process next to the predicted memory (the
+// accounting covers every engine of the process, not only this one)
+void print_memory_report(const cut_engine* e)
+{
+	long long peak[NUM_SUBSYSTEMS], bytes[NUM_SUBSYSTEMS], count;
+	memory_usage(peak, bytes, count);
+	long long total = 0;
+	cout << endl << "Memory accounting of the process:" << endl;
+	for(int i = 0; i < NUM_SUBSYSTEMS; i++)
+	{
+		total += peak[i];
+		cout << "  " << subsystem_names[i] << ": " << peak[i] << " bytes at the peak, " << bytes[i] << " bytes allocated" << endl;
+	}
+	cout << "  " << count << " allocations, " << total << " bytes at the peaks of the subsystems" << endl;
+	size_t resident = peak_memory();
+	size_t predicted = predicted_memory(e);
+	cout << "  peak resident memory: " << resident << " bytes, predicted by the memory model: " << predicted
+		 << " bytes (" << (predicted > 0 ? resident * 100 / predicted : 0) << "%, with the program itself)" << endl;
+}
+
+/* METRICS OF A RUN IN JSON
+ *
+ * One object on a single line, for dashboards: the graph, the parameters, the
+ * time of each phase since the graph was loaded (in seconds), the total time,
+ * the AND vertices evaluated per second of enumeration (and of decoding in
+ * streaming mode, where both overlap), the bytes of the file read per second
+ * of header parsing and decoding, the peak resident memory of the process and
+ * the size of the cut store. With the perf-counters option, the counts of
+ * each phase are added (null for the counters not available, or for all of
+ * them if none is). The memory object has the peak of each subsystem of the
+ * memory accounting, the number of allocations and the predicted memory.
+ * Built with PK_STATS, the statistics of the cut enumeration are added too.
+******************************************************************************/
+void print_metrics(const cut_engine* e, const char* filename, double total)
+{
+	struct stat status;
+	size_t file_bytes = stat(filename, &status) == 0 ? status.st_size : 0;
+	int evaluated = e->computed ? 0 : lazy_evaluated(e);
+	for(int i = e->I; i < e->M && e->computed; i++) if(e->vertices[i].winner != -1) evaluated++;
+
+	const double* seconds = e->phase_seconds;
+	double evaluation = seconds[PHASE_ENUMERATION] + (e->options.stream ? seconds[PHASE_DECODE] : 0);
+	double reading = seconds[PHASE_HEADER] + seconds[PHASE_DECODE];
+	string file = filename;
+	for(size_t i = 0; i < file.size(); i++)
+		if(file[i] == '"' || file[i] == '\\') file.insert(i++, 1, '\\');
+
+	cout.unsetf(ios::fixed);
+	cout.precision(9);
+	cout << "{\"file\":\"" << file << "\",\"k\":" << e->k << ",\"p\":" << e->p << ",\"engine\":\"" << (e->options.stream ? "stream" : engine_names[e->options.engine]) << "\""
+		 << ",\"threads\":" << e->options.threads << ",\"vertices\":" << e->M << ",\"inputs\":" << e->I << ",\"outputs\":" << e->O
+		 << ",\"evaluated\":" << evaluated << ",\"phases\":{";
+	for(int i = 0; i < NUM_PHASES; i++) cout << (i > 0 ? "," : "") << "\"" << phase_names[i] << "\":" << seconds[i];
+	cout << "},\"total\":" << total
+		 << ",\"nodes_per_second\":" << (evaluation > 0 ? evaluated / evaluation : 0)
+		 << ",\"bytes_per_second\":" << (reading > 0 ? file_bytes / reading : 0)
+		 << ",\"file_bytes\":" << file_bytes << ",\"peak_memory\":" << peak_memory()
+		 << ",\"cut_memory\":" << (e->cut_costs != NULL ? cut_store_bytes(e) : 0);
+	long long peak[NUM_SUBSYSTEMS], bytes[NUM_SUBSYSTEMS], count;
+	memory_usage(peak, bytes, count);
+	cout << ",\"memory\":{";
+	for(int i = 0; i < NUM_SUBSYSTEMS; i++) cout << "\"" << subsystem_names[i] << "\":" << peak[i] << ",";
+	cout << "\"allocations\":" << count << ",\"predicted\":" << predicted_memory(e) << "}";
+	if(e->options.perf_counters && !counting(e)) cout << ",\"counters\":null";
+	else if(e->options.perf_counters)
+	{
+		cout << ",\"counters\":{";
+		for(int i = 0; i < NUM_PHASES; i++)
+		{
+			cout << (i > 0 ? "," : "") << "\"" << phase_names[i] << "\":{";
+			for(int j = 0; j < NUM_COUNTERS; j++)
+			{
+				cout << (j > 0 ? "," : "") << "\"" << counter_names[j] << "\":";
+				if(e->phase_counters[i][j] >= 0) cout << (unsigned long long)e->phase_counters[i][j];
+				else cout << "null";
+			}
+			cout << "}";
+		}
+		cout << "}";
+	}
+	print_statistics_json();
+	cout << "}" << endl;
+}
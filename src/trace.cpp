@@ -0,0 +1,199 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include "graph.h"
+using namespace std;
+
+// functions and procedures implemented elsewhere
+double wall_time();
+
+// calls of compute_kcuts in a sampled span of the timeline
+#define TRACE_BATCH 4096
+
+// events of the trace of an engine, in the Chrome trace event format; the
+// engine holds a reference, and so do the threads that add events to it
+// without knowing their engine (the allocation layer and the sampled spans of
+// compute_kcuts), so a thread never writes to a trace already released
+typedef struct tl {
+	string path;
+	double origin;          // time of the first event, in seconds
+	vector<string> events;
+	map<thread::id, int> threads;   // number of each thread seen, from 1
+	mutex lock;
+	atomic<int> references;
+} trace_log;
+
+void retain_trace(trace_log* trace)
+{
+	trace->references.fetch_add(1);
+}
+
+void release_trace(trace_log* trace)
+{
+	if(trace->references.fetch_sub(1) == 1) delete trace;
+}
+
+// adds an event to a trace, with the process and the thread
+void add_event(trace_log* trace, const string& event)
+{
+	lock_guard<mutex> lock(trace->lock);
+	int& number = trace->threads[this_thread::get_id()];
+	if(number == 0)
+	{
+		number = trace->threads.size();
+		string name = number == 1 ? "main" : "worker " + to_string(number - 1);
+		trace->events.push_back("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + to_string(getpid()) + ",\"tid\":"
+			+ to_string(number) + ",\"args\":{\"name\":\"" + name + "\"}}");
+	}
+	trace->events.push_back(event + ",\"pid\":" + to_string(getpid()) + ",\"tid\":" + to_string(number) + "}");
+}
+
+// timestamp of a time in a trace, in microseconds
+inline string timestamp(const trace_log* trace, double time)
+{
+	return to_string((long long)((time - trace->origin) * 1e6));
+}
+
+// adds a span (a complete event) from start to end, in seconds
+void add_span(trace_log* trace, const char* name, const char* category, double start, double end, const string& args)
+{
+	add_event(trace, string("{\"name\":\"") + name + "\",\"cat\":\"" + category + "\",\"ph\":\"X\",\"ts\":" + timestamp(trace, start)
+		+ ",\"dur\":" + to_string((long long)((end - start) * 1e6)) + (args.empty() ? "" : ",\"args\":{" + args + "}"));
+}
+
+// adds a span to the trace of an engine (called only while it is traced)
+void trace_span(const cut_engine* e, const char* name, const char* category, double start, double end, const string& args)
+{
+	add_span((trace_log*)e->trace, name, category, start, end, args);
+}
+
+/* EVENTS OF THE ALLOCATION LAYER
+ * The allocation layer does not know the engine it allocates for: each thread
+ * records its allocations in the trace set by configure_memory, like its
+ * policies of huge pages and NUMA nodes.
+******************************************************************************/
+typedef struct mt {
+	trace_log* trace;
+	~mt();
+} memory_trace;
+thread_local memory_trace allocation_trace = { NULL };
+
+// sets the trace of the next allocations of the calling thread (NULL: none)
+void trace_memory(void* trace)
+{
+	if(trace == allocation_trace.trace) return;
+	if(trace != NULL) retain_trace((trace_log*)trace);
+	if(allocation_trace.trace != NULL) release_trace(allocation_trace.trace);
+	allocation_trace.trace = (trace_log*)trace;
+}
+
+mt::~mt()
+{
+	trace_memory(NULL);
+}
+
+// adds an allocation or a release of the allocation layer, with the memory
+// mapped by the layer after it
+void trace_allocation(const char* name, size_t bytes, bool allocated, long long mapped)
+{
+	trace_log* trace = allocation_trace.trace;
+	if(trace == NULL) return;
+	string now = timestamp(trace, wall_time());
+	add_event(trace, string("{\"name\":\"") + (allocated ? "allocate " : "free ") + name + "\",\"cat\":\"memory\",\"ph\":\"i\",\"s\":\"t\",\"ts\":"
+		+ now + ",\"args\":{\"bytes\":" + to_string(bytes) + "}");
+	add_event(trace, "{\"name\":\"mapped memory\",\"cat\":\"memory\",\"ph\":\"C\",\"ts\":" + now + ",\"args\":{\"bytes\":" + to_string(mapped) + "}");
+}
+
+/* SAMPLED SPANS OF COMPUTE_KCUTS
+ * Each thread counts its calls, and every TRACE_BATCH calls (or when it ends,
+ * or at the end of the enumeration phase for the thread that ends it) adds
+ * one span from the first to the last call of the batch: two clock readings
+ * per batch instead of two per vertex.
+******************************************************************************/
+typedef struct tb {
+	trace_log* trace;     // trace of the batch (a reference is held while calls > 0)
+	int calls;
+	double start;
+	~tb();
+} trace_batch;
+thread_local trace_batch kernel_batch;
+
+void flush_kernel_batch()
+{
+	if(kernel_batch.calls == 0) return;
+	add_span(kernel_batch.trace, "compute_kcuts", "kernel", kernel_batch.start, wall_time(), "\"calls\":" + to_string(kernel_batch.calls));
+	release_trace(kernel_batch.trace);
+	kernel_batch.trace = NULL;
+	kernel_batch.calls = 0;
+}
+
+tb::~tb()
+{
+	flush_kernel_batch();
+}
+
+// counts a call of compute_kcuts for the trace of an engine (only called while
+// it is traced)
+void trace_kernel_call(const cut_engine* e)
+{
+	trace_log* trace = (trace_log*)e->trace;
+	if(kernel_batch.calls > 0 && kernel_batch.trace != trace) flush_kernel_batch();
+	if(kernel_batch.calls == 0)
+	{
+		retain_trace(trace);
+		kernel_batch.trace = trace;
+		kernel_batch.start = wall_time();
+	}
+	if(++kernel_batch.calls == TRACE_BATCH) flush_kernel_batch();
+}
+
+/* TIMELINE OF A RUN (CHROME TRACE EVENTS)
+ *
+ * With the trace option, the events of an engine are recorded from the moment
+ * a graph is loaded until the engine is destroyed, and then written as a JSON
+ * file in the trace event format of Chrome and Perfetto: the calls of
+ * load_graph and compute_cuts, the phases (see timing.cpp), sampled spans of
+ * the calls of compute_kcuts on each thread, and the allocations and releases
+ * of the allocation layer with a counter of the memory mapped by the process.
+ * Each engine has its own trace, so engines traced at the same time on
+ * different threads write to different files (given different paths). The
+ * events of the worker processes of the partitioned engine are not seen.
+******************************************************************************/
+void open_trace(cut_engine* e)
+{
+	if(e->options.trace == NULL || e->trace != NULL) return;
+	trace_log* trace = new trace_log();
+	trace->path = e->options.trace;
+	trace->origin = wall_time();
+	trace->references.store(1);
+	trace->events.push_back("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + to_string(getpid())
+		+ ",\"args\":{\"name\":\"priokcuts\"}}");
+	e->trace = trace;
+}
+
+// stops the trace of an engine and writes it; the events the threads of the
+// engine have not flushed yet (at their exit) are not written
+void close_trace(cut_engine* e)
+{
+	trace_log* trace = (trace_log*)e->trace;
+	if(trace == NULL) return;
+	if(kernel_batch.trace == trace) flush_kernel_batch();
+	if(allocation_trace.trace == trace) trace_memory(NULL);
+	e->trace = NULL;
+
+	{
+		lock_guard<mutex> lock(trace->lock);
+		ofstream output(trace->path.c_str());
+		output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+		for(size_t i = 0; i < trace->events.size(); i++) output << trace->events[i] << (i + 1 < trace->events.size() ? "," : "") << endl;
+		output << "]}" << endl;
+		if(!output) cerr << "Failed to write the trace to " << trace->path << "." << endl;
+	}
+	release_trace(trace);
+}
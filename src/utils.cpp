@@ -1,16 +1,23 @@
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
-#include <ctime>
+#include <string>
 #include <vector>
 #include "graph.h"
 using namespace std;
 
-// evaluates and show the time taken to do something
-void evaluate_time(const char* message, clock_t& start, clock_t& end)
+// functions and procedures implemented elsewhere
+void* allocate_memory(size_t bytes, const char* name);
+int original_label(const cut_engine* e, int label);
+bool parse_budget(const char* value, double& bytes, double& percent);
+bool adaptive_budget(const cut_engine* e);
+int allocate_adaptive_store(cut_engine* e);
+
+// evaluates and show the time taken to do something (start and end are times
+// of the monotonic clock, see timing.cpp)
+void evaluate_time(const char* message, double start, double end)
 {
-    double time_spent = 0.0;
-	time_spent += ((double)(end - start) / CLOCKS_PER_SEC);
+    double time_spent = end - start;
 	cout.setf(std::ios::fixed);
 	string time_sec = to_string(time_spent);
 	string time_msec = to_string((time_spent*1000.0));
@@ -33,15 +40,191 @@ void show_help(char* argv[])
 		cerr << "  \e[1mOptions\e[0m:" << endl << endl;
 		cerr << "  -k <value>     The maximum number of inputs for each cut." << endl;
 		cerr << "  -p <value>     The number of prioriry cuts stored for each vertex." << endl;
+		cerr << "                 Comma separated lists of values of -k and -p (-k 4,6,8 -p 2,4)" << endl;
+        cerr << "                 evaluate every configuration on the same graph in one run." << endl;
+		cerr << "  -t <value>     The number of threads used by the parallel engines." << endl;
 		cerr << "  -d             Display the results on the screen (slow down the execution time" << endl;
-        cerr << "                 for large graphs)." << endl << endl;
+        cerr << "                 for large graphs)." << endl;
+		cerr << "  --layout <l>   Memory layout of the cuts: 'split' (costs and inputs in separate" << endl;
+        cerr << "                 arrays, default) or 'aos' (interleaved per-vertex records)." << endl;
+		cerr << "  --engine <e>   How the vertices are visited: 'dfs' (depth-first from each output," << endl;
+        cerr << "                 default), 'levels' (level by level on -t threads) or 'dag' (as soon" << endl;
+        cerr << "                 as the children are ready, with work stealing on -t threads) or" << endl;
+        cerr << "                 'sweep' (one pass over the vertices in index order)." << endl;
+		cerr << "  --cone <list>  Evaluate only the cones of the outputs at the given positions" << endl;
+        cerr << "                 (comma separated, starting at 0)." << endl;
+		cerr << "  --partitions <n>  Split the graph in n partitions evaluated by n worker" << endl;
+        cerr << "                 processes sharing the cuts through POSIX shared memory." << endl;
+		cerr << "  --stream       Evaluate every AND vertex while the file is read, with another" << endl;
+        cerr << "                 heuristic: the cuts are ranked by costs not divided by the" << endl;
+        cerr << "                 fanouts, which are only known at the end, so the cuts kept" << endl;
+        cerr << "                 differ from the engines (not with --cone or --engine)." << endl;
+		cerr << "  --eco <file>   After the cuts are evaluated, apply the edits listed in the file" << endl;
+        cerr << "                 ('replace <label> <rhs0> <rhs1>', 'add <rhs0> <rhs1>'," << endl;
+        cerr << "                 'remove <label>' or 'output <position> <literal>', one per" << endl;
+        cerr << "                 line) and update only the cuts of their transitive fanout." << endl;
+		cerr << "  --nodes <list> Evaluate only the cuts of the vertices with the given labels" << endl;
+        cerr << "                 (comma separated, or a file of labels) and of their fanin" << endl;
+        cerr << "                 (one value of -k and -p; not with --eco)." << endl;
+		cerr << "  --batch <results> Take <file> as a manifest (one AIG file per line) or a directory" << endl;
+        cerr << "                 of AIG files and evaluate the cuts of each one, -t files at a" << endl;
+        cerr << "                 time, writing one JSON line per file with its times to results" << endl;
+        cerr << "                 (one value of -k and -p; not with --nodes, --eco, --serve or -d)." << endl;
+		cerr << "  --serve <socket> After the cuts are evaluated, answer queries for the cuts of" << endl;
+        cerr << "                 vertices on a Unix domain socket until a client asks for a" << endl;
+        cerr << "                 shutdown or SIGINT/SIGTERM (protocol in priokcuts.h)." << endl;
+		cerr << "  --cache <dir>  Keep the computed cuts in a directory, indexed by the contents" << endl;
+        cerr << "                 of the graph, k and p, and reuse them in the next runs." << endl;
+		cerr << "  --strash       Merge the AND vertices with the same inputs and remove the ones" << endl;
+        cerr << "                 not reachable from the outputs before evaluating the cuts." << endl;
+		cerr << "  --budget <b>   Give each vertex its own number of cuts, from 2 to p, by its fanout" << endl;
+        cerr << "                 and level, within a memory budget for the cuts: bytes (with a K," << endl;
+        cerr << "                 M or G suffix) or a percentage of p cuts per vertex (40%)." << endl;
+		cerr << "  --reuse        Reuse the cuts of vertices whose children have the same cuts up" << endl;
+        cerr << "                 to a renaming of the leaves (dfs and sweep engines)." << endl;
+		cerr << "  --metrics json Print the time of each phase, the vertices evaluated and the bytes" << endl;
+        cerr << "                 read per second and the peak memory as one JSON line, instead" << endl;
+        cerr << "                 of the progress messages (one configuration: not with lists" << endl;
+        cerr << "                 of values for -k or -p)." << endl;
+		cerr << "  --memory-report Show the memory of the graph, the cuts, the stacks and the" << endl;
+        cerr << "                 temporaries, the number of allocations and the peak resident" << endl;
+        cerr << "                 memory next to the memory predicted by the model of the README." << endl;
+		cerr << "  --trace <file> Write a timeline of the run (phases, batches of compute_kcuts calls" << endl;
+        cerr << "                 on each thread, allocations) in the Chrome trace event format." << endl;
+		cerr << "  --perf-counters Count the cycles, instructions, L1 and last level cache misses," << endl;
+        cerr << "                 data TLB misses and branch misses of each phase (Linux" << endl;
+        cerr << "                 perf_event_open; the counters not available are left out)." << endl;
+		cerr << "  --hugepages    Back the graph and the cuts with 1 GiB or 2 MiB huge pages when" << endl;
+        cerr << "                 available (transparent huge pages otherwise)." << endl;
+		cerr << "  --numa <n>     NUMA placement of the graph and the cuts: 'default', 'interleave'" << endl;
+        cerr << "                 or 'firsttouch'." << endl << endl;
 		cerr << "  -h --help      This help." << endl << endl;
 		cerr << "  If not provided, the values of p and k are set to 2 and 4, respectively, and " << endl;
-        cerr << "  display is set to false." << endl << endl;
+        cerr << "  display is set to false. The parallel engines use all the cores by default." << endl << endl;
+}
+
+// parses a comma separated list of values (-k 4,6,8), returning the first one
+int parse_values(char* list, int* values, int& count)
+{
+	count = 0;
+	char* token = strtok(list, ",");
+	while(token != NULL)
+	{
+		if(count == MAX_SWEEP)
+		{
+			cerr << "FAIL. At most " << MAX_SWEEP << " values can be given to -k and -p." << endl;
+			exit(-1);
+		}
+		values[count++] = atoi(token);
+		token = strtok(NULL, ",");
+	}
+	return count > 0 ? values[0] : 0;
+}
+
+// records an error in the engine and returns its code
+int fail(cut_engine* e, int error, const string& message)
+{
+	e->error = error;
+	e->message = message;
+	return error;
+}
+
+// sets an option given by its name (the long command line option without
+// the dashes) and its value (NULL for flags, which also take "1" or "0")
+// returns PK_OK, PK_ERROR_ARGUMENT for a missing or wrong value, or
+// PK_ERROR_OPTION for an unknown option
+int set_option(run_options& options, const char* name, const char* value)
+{
+	bool on = value == NULL || strcmp(value, "1") == 0;
+	bool off = value != NULL && strcmp(value, "0") == 0;
+	if(strcmp(name, "layout") == 0)
+	{
+		if(value != NULL && strcmp(value, "split") == 0) options.layout = LAYOUT_SPLIT;
+		else if(value != NULL && strcmp(value, "aos") == 0) options.layout = LAYOUT_AOS;
+		else return PK_ERROR_ARGUMENT;
+	}
+	else if(strcmp(name, "engine") == 0)
+	{
+		if(value != NULL && strcmp(value, "dfs") == 0) options.engine = ENGINE_DFS;
+		else if(value != NULL && strcmp(value, "levels") == 0) options.engine = ENGINE_LEVELS;
+		else if(value != NULL && strcmp(value, "dag") == 0) options.engine = ENGINE_DAG;
+		else if(value != NULL && strcmp(value, "sweep") == 0) options.engine = ENGINE_SWEEP;
+		else return PK_ERROR_ARGUMENT;
+	}
+	else if(strcmp(name, "threads") == 0)
+	{
+		if(value == NULL || atoi(value) < 1) return PK_ERROR_ARGUMENT;
+		options.threads = atoi(value);
+	}
+	else if(strcmp(name, "cone") == 0)
+	{
+		if(value == NULL || value[0] == '-') return PK_ERROR_ARGUMENT;
+		free(options.cone);
+		options.cone = value[0] != '\0' ? strdup(value) : NULL;
+	}
+	else if(strcmp(name, "cache") == 0)
+	{
+		if(value == NULL || value[0] == '-') return PK_ERROR_ARGUMENT;
+		free(options.cache);
+		options.cache = value[0] != '\0' ? strdup(value) : NULL;
+	}
+	else if(strcmp(name, "trace") == 0)
+	{
+		if(value == NULL || value[0] == '-') return PK_ERROR_ARGUMENT;
+		free(options.trace);
+		options.trace = value[0] != '\0' ? strdup(value) : NULL;
+	}
+	else if(strcmp(name, "budget") == 0)
+	{
+		double bytes, percent;
+		if(value == NULL || (value[0] != '\0' && !parse_budget(value, bytes, percent))) return PK_ERROR_ARGUMENT;
+		free(options.budget);
+		options.budget = value[0] != '\0' ? strdup(value) : NULL;
+	}
+	else if(strcmp(name, "partitions") == 0)
+	{
+		if(value == NULL || atoi(value) < 1) return PK_ERROR_ARGUMENT;
+		options.engine = ENGINE_PARTITIONS;
+		options.partitions = atoi(value);
+	}
+	else if(strcmp(name, "stream") == 0)
+	{
+		if(!on && !off) return PK_ERROR_ARGUMENT;
+		options.stream = on;
+	}
+	else if(strcmp(name, "reuse") == 0)
+	{
+		if(!on && !off) return PK_ERROR_ARGUMENT;
+		options.reuse = on;
+	}
+	else if(strcmp(name, "strash") == 0)
+	{
+		if(!on && !off) return PK_ERROR_ARGUMENT;
+		options.strash = on;
+	}
+	else if(strcmp(name, "perf-counters") == 0)
+	{
+		if(!on && !off) return PK_ERROR_ARGUMENT;
+		options.perf_counters = on;
+	}
+	else if(strcmp(name, "hugepages") == 0)
+	{
+		if(!on && !off) return PK_ERROR_ARGUMENT;
+		options.hugepages = on ? HUGEPAGES_ON : HUGEPAGES_OFF;
+	}
+	else if(strcmp(name, "numa") == 0)
+	{
+		if(value != NULL && strcmp(value, "default") == 0) options.numa = NUMA_DEFAULT;
+		else if(value != NULL && strcmp(value, "interleave") == 0) options.numa = NUMA_INTERLEAVE;
+		else if(value != NULL && strcmp(value, "firsttouch") == 0) options.numa = NUMA_FIRSTTOUCH;
+		else return PK_ERROR_ARGUMENT;
+	}
+	else return PK_ERROR_OPTION;
+	return PK_OK;
 }
 
 // process the arguments passed by command line interface
-void process_args(int argc, char* argv[], char*& filename, bool& display, int& p, int& k)
+void process_args(int argc, char* argv[], char*& filename, char*& eco_file, char*& nodes, char*& socket_path, char*& batch_results, bool& display, bool& metrics, bool& memory_report, int& p, int& k, run_options& options)
 {
 
 	int i = 1;	
@@ -67,23 +250,89 @@ void process_args(int argc, char* argv[], char*& filename, bool& display, int& p
 			}
 			else if(arg[1] == '-')
 			{
-				if(strlen(arg) < 6)
-				{
-					cerr << "FAIL. Unknown option." << endl;
-					exit(-1);					
-				}
-				if(arg[2] == 'h' && arg[3] == 'e' && arg[4] == 'l' && arg[5] == 'p')
+				if(strcmp(arg, "--help") == 0)
 				{
 					show_help(argv);
 					exit(-1);
 				}
-				else
+				else if(strcmp(arg, "--eco") == 0)
+				{
+					if(i+1 >= argc || argv[i+1][0] == '-')
+					{
+						cerr << "FAIL. Missing or wrong value for --eco option." << endl;
+						exit(-1);
+					}
+					eco_file = argv[i+1];
+					i += 2;
+					continue;
+				}
+				else if(strcmp(arg, "--nodes") == 0)
+				{
+					if(i+1 >= argc || argv[i+1][0] == '-')
+					{
+						cerr << "FAIL. Missing or wrong value for --nodes option." << endl;
+						exit(-1);
+					}
+					nodes = argv[i+1];
+					i += 2;
+					continue;
+				}
+				else if(strcmp(arg, "--batch") == 0)
+				{
+					if(i+1 >= argc || argv[i+1][0] == '-')
+					{
+						cerr << "FAIL. Missing or wrong value for --batch option." << endl;
+						exit(-1);
+					}
+					batch_results = argv[i+1];
+					i += 2;
+					continue;
+				}
+				else if(strcmp(arg, "--serve") == 0)
+				{
+					if(i+1 >= argc || argv[i+1][0] == '-')
+					{
+						cerr << "FAIL. Missing or wrong value for --serve option." << endl;
+						exit(-1);
+					}
+					socket_path = argv[i+1];
+					i += 2;
+					continue;
+				}
+				else if(strcmp(arg, "--memory-report") == 0)
+				{
+					memory_report = true;
+					i++;
+					continue;
+				}
+				else if(strcmp(arg, "--metrics") == 0)
+				{
+					if(i+1 >= argc || strcmp(argv[i+1], "json") != 0)
+					{
+						cerr << "FAIL. Missing or wrong value for --metrics option." << endl;
+						exit(-1);
+					}
+					metrics = true;
+					i += 2;
+					continue;
+				}
+				// flags take no value
+				bool flag = strcmp(arg, "--stream") == 0 || strcmp(arg, "--hugepages") == 0 || strcmp(arg, "--reuse") == 0 || strcmp(arg, "--strash") == 0 || strcmp(arg, "--perf-counters") == 0;
+				char* nextarg = !flag && i+1 < argc ? argv[i+1] : NULL;
+				int status = set_option(options, arg + 2, nextarg);
+				if(status == PK_ERROR_OPTION)
 				{
 					cerr << "FAIL. Unknown option." << endl;
-					exit(-1);					
+					exit(-1);
+				}
+				else if(status != PK_OK)
+				{
+					cerr << "FAIL. Missing or wrong value for " << arg << " option." << endl;
+					exit(-1);
 				}
+				i += flag ? 1 : 2;
 			}
-			else if(arg[1] == 'k' || arg[1] == 'p')
+			else if(arg[1] == 'k' || arg[1] == 'p' || arg[1] == 't')
 			{
 				if(i+1 < argc)
 				{
@@ -93,8 +342,9 @@ void process_args(int argc, char* argv[], char*& filename, bool& display, int& p
 						cerr << "FAIL. Missing or wrong value for -" << arg[1] << " option." << endl;
 						exit(-1);						
 					}
-					if(arg[1] == 'k') k = atoi(nextarg);
-					if(arg[1] == 'p') p = atoi(nextarg);
+					if(arg[1] == 'k') k = parse_values(nextarg, options.ks, options.num_ks);
+					if(arg[1] == 'p') p = parse_values(nextarg, options.ps, options.num_ps);
+					if(arg[1] == 't') options.threads = atoi(nextarg);
 					i += 2;
 				}
 				else
@@ -122,38 +372,104 @@ void process_args(int argc, char* argv[], char*& filename, bool& display, int& p
 		exit(-1);
 	}
 
+	// without lists, the sweep has the single configuration (k, p)
+	if(options.num_ks == 0)
+	{
+		options.ks[0] = k;
+		options.num_ks = 1;
+	}
+	if(options.num_ps == 0)
+	{
+		options.ps[0] = p;
+		options.num_ps = 1;
+	}
+	// the metrics describe one configuration: the phases of a sweep add up the
+	// times of all of them
+	if(metrics && options.num_ks * options.num_ps > 1)
+	{
+		cerr << "FAIL. --metrics cannot be used with lists of values for -k or -p." << endl;
+		exit(-1);
+	}
+	// the requested vertices are evaluated on demand for one configuration,
+	// without the cut store the edits update
+	if(nodes != NULL && (options.num_ks * options.num_ps > 1 || eco_file != NULL))
+	{
+		cerr << "FAIL. --nodes cannot be used with lists of values for -k or -p or with --eco." << endl;
+		exit(-1);
+	}
+	// a batch writes one line per file, for a single configuration, and
+	// nothing else
+	if(batch_results != NULL && options.num_ks * options.num_ps > 1)
+	{
+		cerr << "FAIL. --batch cannot be used with lists of values for -k or -p." << endl;
+		exit(-1);
+	}
+	if(batch_results != NULL && (nodes != NULL || eco_file != NULL || socket_path != NULL || display))
+	{
+		cerr << "FAIL. --batch cannot be used with --nodes, --eco, --serve or -d." << endl;
+		exit(-1);
+	}
+	// the smallest values are the ones checked
+	for(int j = 0; j < options.num_ks; j++) if(options.ks[j] < k) k = options.ks[j];
+	for(int j = 0; j < options.num_ps; j++) if(options.ps[j] < p) p = options.ps[j];
 	if(p < 2 || k < 2)
 	{
 		cerr << "FAIL. Minimal value for -k and -p is 2." << endl;
 		exit(-1);
 	}
 
+	if(options.threads < 1)
+	{
+		cerr << "FAIL. Minimal value for -t is 1." << endl;
+		exit(-1);
+	}
+
 }
 
-// prints the cuts of a vertex on screen
-void print_cuts(int vertex_index, int& p, int& k, float*& cut_costs, int*& cut_inputs)
+// prints a list of p cuts (the costs, then the inputs of each cut) on screen
+void print_cut_list(int vertex_label, float* costs, int* inputs, int p, int k)
 {
-	int vertex_label = (vertex_index+1) << 1;
 	cout << "v[" << vertex_label << "] cuts:" << endl;
 	for(int i = 0; i < p; i++)
 	{
-		if(cut_costs[vertex_index*p+i] != -1) {
+		if(costs[i] != -1) {
 			cout << "  {'cut':{";
 			for(int j = 0; j < k; j++)
             {
-				if(cut_inputs[vertex_index*p*k+i*k+j] != -1)
+				if(inputs[i*k+j] != -1)
                 {
-                    cout << cut_inputs[vertex_index*p*k+i*k+j];
-                    if(j < k-1 && cut_inputs[vertex_index*p*k+i*k+j+1] != -1) cout << ",";
+                    cout << inputs[i*k+j];
+                    if(j < k-1 && inputs[i*k+j+1] != -1) cout << ",";
                 }
             }
-			cout << "},'cost':" << cut_costs[vertex_index*p+i] << "}" << endl;
+			cout << "},'cost':" << costs[i] << "}" << endl;
 		}
 	}
 }
 
+// prints the p cuts of a vertex on screen under the label of the file given,
+// with the leaves translated to the labels of the file (see strash.cpp)
+void print_vertex_cuts(cut_engine* e, int label, float* costs, int* inputs, int p)
+{
+	if(e->original_labels == NULL)
+	{
+		print_cut_list(label, costs, inputs, p, e->k);
+		return;
+	}
+	vector<int> leaves(inputs, inputs + p*e->k);
+	for(int l = 0; l < leaves.size(); l++) if(leaves[l] != -1) leaves[l] = original_label(e, leaves[l]);
+	print_cut_list(label, costs, &leaves[0], p, e->k);
+}
+
+// prints the cuts of every evaluated vertex
+void print_graph_cuts(cut_engine* e)
+{
+	for(int i = 0; i < e->M; i++)
+		if(e->vertices[i].winner != -1) print_vertex_cuts(e, original_label(e, (i+1) << 1), &e->cut_costs[cost_start(e, i)], &e->cut_inputs[input_start(e, i)], cut_slots(e, i));
+}
+
 // check if a vertex is in the list
-bool in_the_list(int vertex_index, vector<int>* list)
+bool in_the_list(int vertex_index, product_list* list)
 {
 	for(int i = 0; i < list->size(); i++)
 		if(list->at(i) == vertex_index) 
@@ -162,35 +478,138 @@ bool in_the_list(int vertex_index, vector<int>* list)
 }
 
 // return the index of the winning cut in the cut's cost list
-int winner_cut(int vertex_index, float* cut_costs, int& p)
+int winner_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset)
 {
-	int winner_cost = cut_costs[vertex_index*p];
-	int winner_index = vertex_index*p + 0;
+	int winner_cost = cut_costs[vertex_index*cost_offset];
+	int winner_index = vertex_index*cost_offset + 0;
 	for(int j = 0; j < p; j++)
 	{
-		if(cut_costs[vertex_index*p + j] < 0) continue;
-		if(winner_cost >= cut_costs[vertex_index*p + j] ||
-		cut_costs[vertex_index*p + j] > 0 && winner_cost < 0)
+		if(cut_costs[vertex_index*cost_offset + j] < 0) continue;
+		if(winner_cost >= cut_costs[vertex_index*cost_offset + j] ||
+		cut_costs[vertex_index*cost_offset + j] > 0 && winner_cost < 0)
 		{
-			winner_cost = cut_costs[vertex_index*p + j];
-			winner_index = vertex_index*p + j;
+			winner_cost = cut_costs[vertex_index*cost_offset + j];
+			winner_index = vertex_index*cost_offset + j;
 		}
 	}
 	return winner_index;
 }
 
 // return the index of the loser cut in the vertex cut list
-int loser_cut(int vertex_index, float* cut_costs, int& p)
+int loser_cut(int vertex_index, float* cut_costs, int& p, int& cost_offset)
 {
 	float loser_cost = 0;
 	int loser_index = 0;
 	for(int j = 0; j < p; j++)
 	{
-		if(loser_cost <= cut_costs[vertex_index*p + j])
+		if(loser_cost <= cut_costs[vertex_index*cost_offset + j])
 		{
-			loser_cost = cut_costs[vertex_index*p + j];
+			loser_cost = cut_costs[vertex_index*cost_offset + j];
 			loser_index = j;
 		}
 	}
 	return loser_index;
-}
\ No newline at end of file
+}
+
+// marks the AND vertices in the transitive fanin of the outputs, only the ones
+// not evaluated yet or all of them (children always have lower indices than
+// their parents, so one pass from the last vertex down to the first input
+// marks the whole cone)
+// returns the number of marked vertices
+int mark_fanin(cut_engine* e, unsigned char* in_cone, bool unevaluated_only)
+{
+	vertex* vertices = e->vertices;
+	int count = 0;
+	for(int i = 0; i < e->O; i++)
+	{
+		int vertex_index = (e->outputs[i] >> 1) - 1;
+		if(vertex_index >= e->I && (!unevaluated_only || vertices[vertex_index].winner == -1)) in_cone[vertex_index] = 1;
+	}
+	for(int i = e->M - 1; i >= e->I; i--)
+	{
+		if(!in_cone[i]) continue;
+		count++;
+		int left_index = vertices[i].left;
+		int right_index = vertices[i].right;
+		if(left_index >= e->I && (!unevaluated_only || vertices[left_index].winner == -1)) in_cone[left_index] = 1;
+		if(right_index >= e->I && (!unevaluated_only || vertices[right_index].winner == -1)) in_cone[right_index] = 1;
+	}
+	return count;
+}
+
+// marks the AND vertices not evaluated yet in the cone of the outputs
+int mark_cone(cut_engine* e, unsigned char* in_cone)
+{
+	return mark_fanin(e, in_cone, true);
+}
+
+// keeps only the outputs at the positions (starting at 0) of a comma separated
+// list, so that only the cones of those outputs are evaluated
+int select_outputs(cut_engine* e, const char* list)
+{
+	vector<int> selected;
+	string positions = list;
+	char* save;
+	char* token = strtok_r(&positions[0], ",", &save);
+	while(token != NULL)
+	{
+		char* end;
+		long position = strtol(token, &end, 10);
+		if(*end != '\0' || position < 0 || position >= e->O)
+			return fail(e, PK_ERROR_ARGUMENT, "Invalid output position in --cone: " + string(token) + ".");
+		selected.push_back(e->outputs[position]);
+		token = strtok_r(NULL, ",", &save);
+	}
+	delete[] e->outputs;
+	e->outputs = new int[selected.size()];
+	for(int i = 0; i < selected.size(); i++) e->outputs[i] = selected[i];
+	e->O = selected.size();
+	return PK_OK;
+}
+
+// allocates the memory used to store the cuts of M vertices
+// split layout: cost_offset = p floats and input_offset = p*k ints per vertex,
+// each kind in its own array
+// AoS layout: one record per vertex with the p costs followed by the p*k
+// inputs, padded to a multiple of the cache line; both offsets are the record
+// size and cut_inputs points p words after cut_costs
+// with an adaptive budget, each vertex has its own number of cuts (see
+// budget.cpp)
+// the memory comes from the allocation layer, which aligns it to pages
+// returns PK_OK or PK_ERROR_MEMORY
+int allocate_cut_store(cut_engine* e)
+{
+	int M = e->M;
+	int p = e->p;
+	int k = e->k;
+	if(adaptive_budget(e)) return allocate_adaptive_store(e);
+	if(e->options.layout == LAYOUT_AOS)
+	{
+		int words_per_line = CACHE_LINE / sizeof(int);
+		int record_words = ((p + p*k + words_per_line - 1) / words_per_line) * words_per_line;
+		void* records = allocate_memory((size_t)M * record_words * sizeof(int), "cut records");
+		if(records == NULL) return fail(e, PK_ERROR_MEMORY, "Failed to allocate " + to_string((size_t)M * record_words * sizeof(int)) + " bytes for the cut records.");
+		e->cut_costs = (float*)records;
+		e->cut_inputs = (int*)records + p;
+		e->cost_offset = record_words;
+		e->input_offset = record_words;
+		e->cut_rows = M;
+		return PK_OK;
+	}
+	e->cost_offset = p;
+	e->input_offset = p*k;
+	e->cut_costs = (float*)allocate_memory((size_t)M*p*sizeof(float), "cut costs");
+	e->cut_inputs = (int*)allocate_memory((size_t)M*p*k*sizeof(int), "cut inputs");
+	if(e->cut_costs == NULL || e->cut_inputs == NULL)
+		return fail(e, PK_ERROR_MEMORY, "Failed to allocate " + to_string((size_t)M*p*(k+1)*sizeof(int)) + " bytes for the cuts.");
+	e->cut_rows = M;
+	return PK_OK;
+}
+
+// returns the size of the cut store, in bytes
+size_t cut_store_bytes(const cut_engine* e)
+{
+	if(e->cut_offsets != NULL) return (size_t)e->cut_offsets[e->M] * (sizeof(float) + e->k * sizeof(int));
+	if(e->options.layout == LAYOUT_AOS) return (size_t)e->M * e->cost_offset * sizeof(int);
+	return (size_t)e->M * (e->cost_offset * sizeof(float) + e->input_offset * sizeof(int));
+}